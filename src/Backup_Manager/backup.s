@@ -3,6 +3,8 @@
 	.global _bram_mem
 	.global _fxbmp_mem
 	.global _bram_buffer
+	.global _diff_buffer
+	.global _overlay_ram
 
 _bram_mem  = 0xE0000000
 _fxbmp_mem = 0xE8000000
@@ -13,3 +15,12 @@ _fxbmp_mem = 0xE8000000
 #
 _bram_buffer = 0x100000
 
+# Second image, used when comparing two images
+# (placed directly after bram_buffer)
+#
+_diff_buffer = 0x108000
+
+# Cold screens are copied here from the cart when first used
+# (must match OVL_ADDR in the Makefile)
+#
+_overlay_ram = 0x110000
@@ -16,84 +16,125 @@
 #include <eris/low/7up.h>
 #include <eris/tetsu.h>
 #include <eris/romfont.h>
-#include <eris/bkupmem.h>
-#include <eris/timer.h>
-#include <eris/pad.h>
 
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#include "flash.h"
+#include "bram.h"
+#include "telemetry.h"
 
-#define JOY_I            1
-#define JOY_II           2
-#define JOY_III          4
-#define JOY_IV           8
-#define JOY_V            16
-#define JOY_VI           32
-#define JOY_SELECT       64
-#define JOY_RUN          128
-#define JOY_UP           256
-#define JOY_RIGHT        512
-#define JOY_DOWN         1024
-#define JOY_LEFT         2048
-#define JOY_MODE1        4096
-#define JOY_MODE2        16384
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 #define TITLE_LINE       1
 #define INSTRUCT_LINE    3
 #define STAT_LINE        5
 #define HEX_LINE         9
 
+#define KRAM_LINE        32              // KRAM words per line of KING BG0 (256 pixels, 4 colors)
+#define GLYPH_ROWS       16              // rows in each ROM font glyph
+#define GLYPH_CACHE_SIZE 128             // expanded glyphs kept in RAM (power of 2)
+
+#define LIST_ROWS        8               // SJIS list window: 8 rows of 16 lines,
+#define LIST_ROW_LINES   16              // starting at screen line HEX_LINE * 8
+#define LIST_TOP_LINE    (HEX_LINE << 3)
+#define LIST_PAGES       2               // pages of a list held in KING BG0 at once,
+#define LIST_PAGE_LINES  256             // this many BG0 lines apart (blank between them)
+#define KING_BG0_LINES   512
+
 #define FX_BASE          0xE0000000      // memory location of start of internal backup memory
 #define FXBMP_BASE       0xE8000000      // memory location of start of external backup memory
-#define FLASH_BANK_BASE  81920           // within FX-BMP cart, start of 'slot' storage
-#define FLASH_BANK_SIZE  (36 * 1024)     // size of 'slot' (32KB for data + 4KB for date/comment metadata)
-#define FLASH_BANK_CMNT  (32 * 1024)     // location of metadata within slot
-#define COMMENT_OFFSET   12              // Ddate is at the start of metadata; this is start of Comment location
+#define OVERLAY_MAX      (OVERLAY_FLASH_SIZE - OVERLAY_HEADER)
 
-#define COMMENT_LENGTH   18
+#define INDEX_MAX_NAMES  256             // unique names tracked across all slots
 
-#define MAX_SLOTS        12              // 12 slots fit in a 512KB Flash chip
+#define FASTBOOT_KEYS    (JOY_I | JOY_II)  // held at boot: restore the fast-restore bank, no menus
 
-// These FAT attributes are for the 32KB internal SRAM
-// on the PC-FX; different values would be used when
-// reporting on larger external memory carts
-//
-#define FAT_OFFSET           0x80
-#define FAT_RESERVED         3
-#define FAT_ENTRIES_32K      236
-#define FAT_SECTOR_SIZE      128
-#define FAT_DIR_OFFSET_32K   0x200
-#define FAT_DIR_ENTRIES_32K  64
-#define FAT_DIR_ENTRY_SIZE   32
+#define BANK_LIST_ROWS   16              // bank rows visible at once in select_bank_menu()
+
+#if (MAX_SLOTS > 32)
+#error "index_slots[] holds one bit per slot; widen it for more than 32 slots"
+#endif
+
+#define DIFF_ADDED           1
+#define DIFF_REMOVED         2
+#define DIFF_CHANGED         3
 
 
-extern void flash_erase_sector( u8 * sector);
-extern void flash_write( u8 * addr, u8 value);
-extern void flash_id( u8 * addr );
+extern void icache_clear(void);
+
+// Screens which are rarely used are marked COLD.  When built for
+// booting from the cart (USE_OVERLAYS), they are linked to run at
+// overlay_ram but stored in the cart at OVERLAY_FLASH instead of in
+// the boot image, and overlay_load() must be called before using them.
+//
+#ifdef USE_OVERLAYS
+#define COLD  __attribute__ ((section ("ovl_cold"), noinline))
+#else
+#define COLD
+#endif
 
 void printsjis(char *text, int x, int y);
 void print_narrow(u32 sjis, u32 kram);
 void print_wide(u32 sjis, u32 kram);
+void glyph_cache_init(void);
+
+void cursor_init(void);
+void cursor_flush(void);
+void cursor_bar(int bar, int x, int y, int width);
+void cursor_hide(void);
+
+extern u8 overlay_ram[];
+
+#define SUP_REG_DCR         0x0F       // HuC6270 DMA control register
+#define SUP_REG_DVSSR       0x13       // HuC6270 SATB address register
+#define SUP_DCR_SATB_AUTO   0x10       // copy the SATB to the sprite table every VSYNC
+
+/* Selection bars are 7up sprites shown behind the text (whose      */
+/* background pixels are transparent), so moving the selection is   */
+/* a few words of SATB rather than a reprint of the rows involved.  */
+#define SPR_PATTERN_ADDR    0x1800     // bar patterns, after the font
+#define SATB_ADDR           0x1F00     // sprite attribute table in VRAM
+#define SATB_ENTRIES        64
+#define CURSOR_BARS         2          // bars which can be on screen together
+#define CURSOR_BAR_SPRITES  8          // 32 pixels (2 cells) each: the HuC6270 shows at most
+#define CURSOR_MAX_WIDTH    32         // 16 sprite cells on a line, so bars are 32 characters at most
+#define CURSOR_WORDS        (CURSOR_BARS * CURSOR_BAR_SPRITES * 4)
+#define CURSOR_PAL          6          // sprite palette - no text uses palette 6
+#define CURSOR_COLOR        0x7066     // lighter shade of the background green
+#define SPR_CGX_32          0x0100     // sprite attribute: 32 pixels wide
+#define SPR_CODE(addr)      ((addr) >> 5)
+
+/* While an SJIS list is shown, vsync() sets KING BG0's vertical */
+/* scroll to list_scroll_y (see king_list_begin())                */
+int  list_shown = 0;
+int  list_scroll_y;
+
+u16  cursor_satb[CURSOR_WORDS];        // SATB entries of the selection bars
+int  cursor_dirty = 0;
+
+/* sprite pattern code for a bar piece 1-4 characters wide */
+const u16 cursor_code[5] = {
+   0,
+   SPR_CODE(SPR_PATTERN_ADDR + 192),   // 16x16, left 8 pixels
+   SPR_CODE(SPR_PATTERN_ADDR),         // 16x16
+   SPR_CODE(SPR_PATTERN_ADDR + 128),   // 32x16, left 24 pixels
+   SPR_CODE(SPR_PATTERN_ADDR)          // 32x16
+};
+
+
+/* ROM font glyphs already expanded to KING 4-color format, */
+/* indexed by a hash of the SJIS code                        */
+u16  glyph_tag[GLYPH_CACHE_SIZE];                  // SJIS code held in each entry (0 = empty)
+u16  glyph_cache[GLYPH_CACHE_SIZE][GLYPH_ROWS * 2]; // left column rows, then right column (wide only)
+u16  glyph_expand[256];                            // 8 font bits -> 8 pixels of color 1
 
-void print_at(int x, int y, int pal, char* str);
-void putch_at(int x, int y, int pal, char c);
-void putnumber_at(int x, int y, int pal, int digits, int value);
-
-extern u8 font[];
-extern u8 bram_mem[];
-extern u8 fxbmp_mem[];
-extern u8 bram_buffer[];
-
-// interrupt-handling variables
-volatile int sda_frame_count = 0;
-volatile int last_sda_frame_count = 0;
+char buffer[2048];
+int  fsck_choice;
 
-/* HuC6270-A's status register (RAM mapping). Used during VSYNC interrupt */
-volatile uint16_t * const MEM_6270A_SR = (uint16_t *) 0x80000400;
+int  listing_action;    // set by buff_listing() when SELECT asks to defragment BRAM
 
+// settings kept in the cart's CONFIG_FLASH sector
+int  config_fast_slot;  // bank restored when FASTBOOT_KEYS are held at boot (1-relative, 0 = none)
 
-char buffer[2048];
-char dir_entry[64][20]; // up to 64 entries of 19 characters (plus null terminator) each (in FAT)
-u32  num_dir_entries;
+int  list_half_top[LIST_PAGES];  // first entry of the page drawn in each part of BG0 (-1 = none)
 
 // Flash memory identifcation and usage:
 u8   chip_id[4];        // first two bytes are buffer for returning flash chip identity
@@ -146,49 +187,186 @@ int banks_in_use;
 int bram_formatted;
 u8 flash_formatted[MAX_SLOTS];
 
+/* details of each slot, fetched only when the slot is first shown; */
+/* slot_cached[] is cleared whenever the card status is re-read     */
+u8   slot_cached[MAX_SLOTS];
 int flash_free[MAX_SLOTS];
 char comment_slot[MAX_SLOTS][COMMENT_LENGTH+2];
 char date_slot[MAX_SLOTS][16];
+u8   fat_buffer[FAT_DIR_OFFSET_32K];   /* boot sector and FAT of one slot */
+
+/* inverted index of directory names -> slots containing them */
+/* kept sorted by name, rebuilt from slot metadata each time  */
+/* the card status is read                                    */
+char index_name[INDEX_MAX_NAMES][20];
+u32  index_slots[INDEX_MAX_NAMES];  /* bit n set = slot n has this name */
+int  index_count;
+
+/* comparison of two backup memory images (bram_buffer vs. diff_buffer) */
+int  compare_stage;                 /* which of the two images is being selected */
+int  compare_from;                  /* first selection (0 = BRAM, n = bank n) */
+u32  cluster_hash_a[FAT_FIRST_CLUSTER + FAT_ENTRIES_32K];
+u32  cluster_hash_b[FAT_FIRST_CLUSTER + FAT_ENTRIES_32K];
+char diff_name[FAT_DIR_ENTRIES_32K * 2][20];
+u8   diff_kind[FAT_DIR_ENTRIES_32K * 2];
+int  num_diff_entries;
+
+
+///////////////////////////////// Joypad repeat
+//
+// the joypad itself is read by console.c; these are the choices of
+// repeat speed offered on the credits screen
+//
+#define REPEAT_PRESETS    3                  // choices on the credits screen (kept in the config sector)
+
+const u8 repeat_preset[REPEAT_PRESETS][2] = {      // delay, rate
+   { 30, 8 },
+   { REPEAT_DELAY, REPEAT_RATE },
+   { 12, 2 }
+};
+char * const repeat_preset_name[REPEAT_PRESETS] = { "Slow  ", "Normal", "Fast  " };
+
+#ifdef PROFILE
+
+// Frame budget profiler (built with -DPROFILE): each frame's work - from
+// one vsync() to the next - is timed, along with the part of it spent in
+// print_at()/printsjis() and in flash_erase()/flash_program().  Frames
+// are kept apart by the menu loop which called vsync() (its address is
+// shown; bank_profile.map gives the function), and the worst and average
+// for the current one are drawn below the panel, as percentages of a frame.
+//
+#define PROF_MENU        0
+#define PROF_PRINT       1
+#define PROF_FLASH       2
+#define PROF_KINDS       3
+
+#define PROF_CALLERS     8
+#define PROF_LINE        26              // below the panel
+#define PROF_INTERVAL    16              // frames between redraws
+#define PROF_AVERAGE     4096            // frames which the average covers (roughly)
+#define PROF_FRAME_TICKS ((TIMER_TICKS_PER_MS * 1000) / 60)
+
+struct prof_caller
+{
+   u32 caller;
+   u32 frames;
+   u32 missed;
+   u32 worst[PROF_KINDS];
+   u32 total[PROF_KINDS];
+};
+
+struct prof_caller prof_table[PROF_CALLERS];
+u32  prof_frame[PROF_KINDS];
+u32  prof_frame_start;
+u32  prof_print_start;
+u32  prof_flash_start;
+
+// printsjis() counts as printing, along with print_at() (console.c)
+#define PROF_BEGIN()      u32 prof_start = ticks_now()
+#define PROF_END()        print_busy_ticks += ticks_now() - prof_start
+
+static struct prof_caller * prof_find(u32 caller)
+{
+int i;
 
+   for (i = 0; i < PROF_CALLERS; i++)
+   {
+      if ((prof_table[i].caller == caller) || (prof_table[i].caller == 0))
+         break;
+   }
+   if (i == PROF_CALLERS)        // full: share the last entry
+      i = PROF_CALLERS - 1;
 
-///////////////////////////////// Joypad routines
-volatile u32 joypad;
-volatile u32 joypad_last;
-volatile u32 joytrg;
+   prof_table[i].caller = caller;
+   return(&prof_table[i]);
+}
 
-__attribute__ ((noinline)) void joyread(void)
+static void prof_draw(struct prof_caller * p)
 {
-u32 temp;
-
-   joypad_last = joypad;
-   temp = eris_pad_read(0);
+char line[48];
+int kind;
+int avg[PROF_KINDS];
+int worst[PROF_KINDS];
 
-   if ((temp >> 28) == PAD_TYPE_FXPAD) {  // PAD TYPE
-      joypad = temp;
-      joytrg = (~joypad_last) & joypad;
-   }
-   else {
-      joypad = 0;
-      joytrg = 0;
+   for (kind = 0; kind < PROF_KINDS; kind++)
+   {
+      worst[kind] = (p->worst[kind] * 100) / PROF_FRAME_TICKS;
+      avg[kind]   = ((p->total[kind] / p->frames) * 100) / PROF_FRAME_TICKS;
    }
+
+   sprintf(line, "%8.8X  menu print flash  missed", (int) p->caller);
+   print_at(2, PROF_LINE, 2, line);
+   sprintf(line, "worst   %4d%% %4d%% %4d%%  %6d", worst[PROF_MENU], worst[PROF_PRINT], worst[PROF_FLASH], (int) p->missed);
+   print_at(2, PROF_LINE + 1, 2, line);
+   sprintf(line, "average %4d%% %4d%% %4d%%", avg[PROF_MENU], avg[PROF_PRINT], avg[PROF_FLASH]);
+   print_at(2, PROF_LINE + 2, 2, line);
 }
 
-///////////////////////////////// Interrupt handler
-__attribute__ ((interrupt_handler)) void my_vblank_irq (void)
+// account for the frame which has just ended, at the start of vsync()
+// (its frame_end_hook)
+//
+static void prof_frame_end(u32 caller, int late)
 {
-   uint16_t vdc_status = *MEM_6270A_SR;
+static u32 frames;
+struct prof_caller * p;
+int kind;
+
+   if (prof_frame_start == 0)    // no frame begun yet
+      return;
 
-   if (vdc_status & 0x20) {
-      sda_frame_count++;
+   prof_frame[PROF_MENU]  = ticks_now() - prof_frame_start;
+   prof_frame[PROF_PRINT] = print_busy_ticks - prof_print_start;
+   prof_frame[PROF_FLASH] = flash_busy_ticks - prof_flash_start;
+
+   p = prof_find(caller);
+   p->frames++;
+   if (late)
+      p->missed++;
+
+   for (kind = 0; kind < PROF_KINDS; kind++)
+   {
+      if (prof_frame[kind] > p->worst[kind])
+         p->worst[kind] = prof_frame[kind];
+      p->total[kind] += prof_frame[kind];
+   }
+
+   if (p->frames == PROF_AVERAGE)
+   {
+      p->frames >>= 1;
+      for (kind = 0; kind < PROF_KINDS; kind++)
+         p->total[kind] >>= 1;
    }
-   joyread();
+
+   if ((++frames % PROF_INTERVAL) == 0)
+      prof_draw(p);
+}
+
+static void prof_frame_begin(void)
+{
+   prof_print_start = print_busy_ticks;
+   prof_flash_start = flash_busy_ticks;
+   prof_frame_start = ticks_now();
 }
 
-void vsync(int numframes)
+#else
+
+#define PROF_BEGIN()
+#define PROF_END()
+
+#endif
+
+// the vsync_hook: at the start of vblank, once vsync() has sent the BAT
+//
+void bank_vblank(void)
 {
-   while (sda_frame_count < (last_sda_frame_count + numframes + 1));
+   if (list_shown)
+      eris_king_set_scroll(KING_BG0, 0, list_scroll_y);
+
+   cursor_flush();
 
-   last_sda_frame_count = sda_frame_count;
+#ifdef PROFILE
+   prof_frame_begin();
+#endif
 }
 
 
@@ -204,200 +382,252 @@ __attribute__ ((noinline)) void step(void)
 }
 //////////
 
-u8 * calc_bank_addr(int banknum)
+void config_load(void)
 {
-   int offset;
+u8 * src;
+
+   src = (u8 *) (FXBMP_BASE + (CONFIG_FLASH * 2));
 
-   offset = (FLASH_BANK_BASE + (banknum * FLASH_BANK_SIZE)) * 2;
-   offset += FXBMP_BASE;
+   config_fast_slot = 0;
+   repeat_delay = REPEAT_DELAY;
+   repeat_rate  = REPEAT_RATE;
+
+   if ((src[0] == 'C') && (src[2] == 'F') && (src[4] == 'G'))
+   {
+      config_fast_slot = src[6];
+      if (config_fast_slot > MAX_SLOTS)
+         config_fast_slot = 0;
 
-   return( (u8 *) offset);
+      // not present (0xFF) in a config written before key repeat was kept
+      if ((src[8] >= 1) && (src[8] <= 60) && (src[10] >= 1) && (src[10] <= 30))
+      {
+         repeat_delay = src[8];
+         repeat_rate  = src[10];
+      }
+   }
 }
 
-u8 * calc_bank_annotate_addr(int banknum)
+void config_save(void)
 {
-   int offset;
+u8 * target;
+
+   target = (u8 *) (FXBMP_BASE + (CONFIG_FLASH * 2));
 
-   offset = (FLASH_BANK_BASE + (banknum * FLASH_BANK_SIZE) + FLASH_BANK_CMNT) * 2;
-   offset += FXBMP_BASE;
+   flash_erase(target);
+   flash_write(target, 'C');
+   flash_write(target + 2, 'F');
+   flash_write(target + 4, 'G');
+   flash_write(target + 6, config_fast_slot);
+   flash_write(target + 8, repeat_delay);
+   flash_write(target + 10, repeat_rate);
 
-   return( (u8 *) offset);
+   telemetry_flush();
 }
 
-void buffer_to_bram()
+
+void copy_annotate_to_buffer(u8 * source)
 {
 int i;
 
-   for (i = 0; i < 32768; i++)
+   for (i = 0; i < 11; i++)
+   {
+      date_buf[i] = *(source + (i<<1));
+   }
+   for (i = 0; i < COMMENT_LENGTH; i++)
    {
-      bram_mem[(i<<1)] = bram_buffer[i];
+      comment_buf[i] = *(source + (COMMENT_OFFSET * 2) + (i<<1));
    }
 }
 
-
-void buffer_to_flash(u8 * target)
+void index_clear(void)
 {
-int i;
+   index_count = 0;
+}
 
-   // erase storage slot (8 sectors data + 1 sector comments)
-   //
-   for (i = 0; i < 9; i++)
-   {
-      flash_erase_sector( target + ((i<<1) * 4096));
-   }
+// binary search of the (sorted) index;
+// returns the position of 'name', or -(insert position)-1 if absent
+//
+int index_find(char * name)
+{
+int lo, hi, mid;
+int cmp;
 
-   // write the core 32KB data into the storage slot
-   // 
-   for (i = 0; i < 32768; i++)
-   {
-      // add special programming preface
-//      *(target + (i<<1)) = bram_buffer[i];
-      flash_write( (target + (i<<1)), bram_buffer[i]);
-   }
+   lo = 0;
+   hi = index_count - 1;
 
-   // add storage of metadata (data / comment)
-   for (i = 0; i < 11; i++)
+   while (lo <= hi)
    {
-//      *(target + (FLASH_BANK_CMNT * 2) + (i * 2)) = date[i];
-      flash_write( (target + (FLASH_BANK_CMNT * 2) + (i * 2)), date[i]);
-   }
-//   *(target + (FLASH_BANK_CMNT * 2) + (11 * 2)) = 0;
-   flash_write( (target + (FLASH_BANK_CMNT * 2) + (11 * 2)), 0);
+      mid = (lo + hi) >> 1;
+      cmp = memcmp(name, index_name[mid], INDEX_NAME_SIZE);
 
+      if (cmp == 0)
+         return(mid);
 
-   for (i = 0; i < COMMENT_LENGTH; i++)
-   {
-//      *(target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (i * 2)) = comment[i];
-      flash_write( (target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (i * 2)), comment[i]);
+      if (cmp < 0)
+         hi = mid - 1;
+      else
+         lo = mid + 1;
    }
-//   *(target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (16 * 2)) = 0;
-   flash_write( (target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (COMMENT_LENGTH * 2)), 0);
+
+   return(-lo - 1);
 }
 
-void copy_to_buffer(u8 * source)
+void index_add(char * name, int slot)
 {
+int pos;
 int i;
 
-   for (i = 0; i < 32768; i++)
+   pos = index_find(name);
+
+   if (pos >= 0)
+   {
+      index_slots[pos] |= (1 << slot);
+      return;
+   }
+
+   if (index_count == INDEX_MAX_NAMES)
+      return;
+
+   pos = -pos - 1;
+
+   for (i = index_count; i > pos; i--)
    {
-      bram_buffer[i] = *(source + (i<<1));
+      memcpy(index_name[i], index_name[i-1], 20);
+      index_slots[i] = index_slots[i-1];
    }
+
+   memset(index_name[pos], 0, 20);
+   memcpy(index_name[pos], name, INDEX_NAME_SIZE);
+   index_slots[pos] = (1 << slot);
+   index_count++;
 }
 
-void copy_annotate_to_buffer(u8 * source)
+void index_load_slot(int slot)
 {
-int i;
+u8 * meta;
+char name_buf[20];
+int count;
+int i, j;
 
-   for (i = 0; i < 11; i++)
+   meta = calc_bank_annotate_addr(slot);
+
+   if ((*(meta + (INDEX_OFFSET * 2)) == 'I') && (*(meta + ((INDEX_OFFSET + 1) * 2)) == 'X'))
    {
-      date_buf[i] = *(source + (i<<1));
+      count = *(meta + ((INDEX_OFFSET + 2) * 2));
+      if (count > FAT_DIR_ENTRIES_32K)
+         count = FAT_DIR_ENTRIES_32K;
+
+      memset(name_buf, 0, 20);
+
+      for (i = 0; i < count; i++)
+      {
+         for (j = 0; j < INDEX_NAME_SIZE; j++)
+         {
+            name_buf[j] = *(meta + ((INDEX_NAMES + (i * INDEX_NAME_SIZE) + j) * 2));
+         }
+         index_add(name_buf, slot);
+      }
    }
-   for (i = 0; i < COMMENT_LENGTH; i++)
+   else
    {
-      comment_buf[i] = *(source + (COMMENT_OFFSET * 2) + (i<<1));
+      // saved before the index existed - read the slot's directory instead
+      copy_directory_to_buffer( calc_bank_addr(slot) );
+      get_buffer_directory();
+
+      for (i = 0; i < num_dir_entries; i++)
+      {
+         index_add(dir_entry[i], slot);
+      }
    }
 }
 
-int check_buffer_free()
+// walk both cluster chains together, comparing cluster hashes
+//
+int chains_differ(int cluster_a, int cluster_b)
 {
-int i;
-int entrya, entryb;
-int available = 0;
-int start_addr, end_addr;
+int steps;
+int valid_a, valid_b;
 
-   start_addr = FAT_OFFSET + FAT_RESERVED;
-   end_addr = start_addr + (FAT_ENTRIES_32K * 3 / 2);
-
-   for (i = start_addr; i < end_addr; i += 3)
+   for (steps = 0; steps < FAT_ENTRIES_32K; steps++)
    {
-      entrya = ((bram_buffer[i+1] & 0xf) << 8) + bram_buffer[i];
-      entryb = (bram_buffer[i+2] << 4) + ((bram_buffer[i+1] & 0xf0) >> 4);
+      valid_a = fat_valid_cluster(cluster_a);
+      valid_b = fat_valid_cluster(cluster_b);
+
+      if (!valid_a || !valid_b)
+         return(valid_a != valid_b);
 
-      if (entrya == 0)
-         available += FAT_SECTOR_SIZE;
+      if (cluster_hash_a[cluster_a] != cluster_hash_b[cluster_b])
+         return(1);
 
-      if (entryb == 0)
-         available += FAT_SECTOR_SIZE;
+      cluster_a = fat_entry(bram_buffer, cluster_a);
+      cluster_b = fat_entry(diff_buffer, cluster_b);
    }
+   return(0);
+}
 
-   return(available);
+void diff_add(char * name, int kind)
+{
+   memcpy(diff_name[num_diff_entries], name, 20);
+   diff_kind[num_diff_entries] = kind;
+   num_diff_entries++;
 }
 
-void get_buffer_directory(void)
+// compare the image in bram_buffer ('from') with the one in diff_buffer ('to')
+// and record each file which was added, removed or changed
+//
+void diff_images(void)
 {
 int i;
-int j, k;
-int start_addr, end_addr;
+int other;
+char name[20];
+u32 size_a, size_b;
+int start_a, start_b;
 
-   num_dir_entries = 0;     // clear previous records
-   for (j = 0; j < 64; j++)
-   {
-      for (k = 0; k < 20; k++)
-      {
-         dir_entry[j][k] = 0;
-      }
-   }
+   num_diff_entries = 0;
 
-   start_addr = FAT_DIR_OFFSET_32K;
-   end_addr = start_addr + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE);
+   fat_hash_clusters(bram_buffer, cluster_hash_a);
+   fat_hash_clusters(diff_buffer, cluster_hash_b);
 
-   for (i = start_addr; i < end_addr; i += FAT_DIR_ENTRY_SIZE)
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
    {
       if (bram_buffer[i] == 0)
          break;
 
-      if (bram_buffer[i] == '.')
+      if (!dir_entry_used(bram_buffer, i))
          continue;
 
-      if (bram_buffer[i] == 0xE5)
-         continue;
+      dir_entry_name(bram_buffer, i, name);
+      other = dir_find_entry(diff_buffer, name);
 
-      for (j = 0; j < 8; j++)
+      if (other == 0)
       {
-         dir_entry[num_dir_entries][j] = bram_buffer[i+j];
-      }
-      for (j = 12; j < 21; j++)
-      {
-         dir_entry[num_dir_entries][j-4] = bram_buffer[i+j];
+         diff_add(name, DIFF_REMOVED);
+         continue;
       }
-      num_dir_entries++;
-   }
-
-   return;
-}
 
+      memcpy(&size_a, &bram_buffer[i + DIR_FILE_SIZE], 4);
+      memcpy(&size_b, &diff_buffer[other + DIR_FILE_SIZE], 4);
+      start_a = bram_buffer[i + DIR_START_CLUSTER] + (bram_buffer[i + DIR_START_CLUSTER + 1] << 8);
+      start_b = diff_buffer[other + DIR_START_CLUSTER] + (diff_buffer[other + DIR_START_CLUSTER + 1] << 8);
 
-int is_bram_formatted()
-{
-static int retval;
+      if ((size_a != size_b) || chains_differ(start_a, start_b))
+         diff_add(name, DIFF_CHANGED);
+   }
 
-   if ((bram_mem[6] == 'P') && (bram_mem[8] == 'C') &&
-       (bram_mem[10] == 'F') && (bram_mem[12] == 'X') &&
-       (bram_mem[14] == 'S') && (bram_mem[16] == 'r') &&
-       (bram_mem[18] == 'a') && (bram_mem[20] == 'm'))
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (diff_buffer[i] == 0)
+         break;
 
-      retval = 1;
-   else
-      retval = 0;
+      if (!dir_entry_used(diff_buffer, i))
+         continue;
 
-   return(retval);
+      dir_entry_name(diff_buffer, i, name);
+      if (dir_find_entry(bram_buffer, name) == 0)
+         diff_add(name, DIFF_ADDED);
+   }
 }
 
-u8 is_formatted(u8 * buf)
-{
-static int retval;
-
-   if ((buf[6] == 'P') && (buf[8] == 'C') &&
-       (buf[10] == 'F') && (buf[12] == 'X') &&
-       (buf[14] == 'S') && (buf[16] == 'r') &&
-       (buf[18] == 'a') && (buf[20] == 'm'))
-
-      retval = 1;
-   else
-      retval = 0;
-
-   return(retval);
-}
 
 void clear_panel(void)
 {
@@ -407,6 +637,7 @@ void clear_panel(void)
    {
       print_at(2, i, 0, "                                         ");
    }
+   cursor_hide();
 }
 
 
@@ -420,6 +651,65 @@ void clear_buff_listing(void)
    }
 }
 
+// SJIS lists are drawn into KING BG0 a page (LIST_ROWS entries) at a
+// time, and LIST_PAGES pages are kept there - page p in the BG0 lines
+// from (p % LIST_PAGES) * LIST_PAGE_LINES - so paging back and forth
+// only draws pages which are not already there.  Showing a page is a
+// change of BG0's scroll at vblank: the lines above and below the list
+// window then fall in the blank lines between the pages, so no other
+// SJIS text can be shown until king_list_end().
+//
+void king_list_begin(void)
+{
+int i;
+
+   for (i = 0; i < LIST_PAGES; i++)
+      list_half_top[i] = -1;
+
+   king_kram_fill(0, 0, KRAM_LINE * KING_BG0_LINES);
+   list_scroll_y = (0 - LIST_TOP_LINE) & (KING_BG0_LINES - 1);
+   list_shown = 1;
+}
+
+// show entries top..top+LIST_ROWS-1 of names[] ('top' is a multiple of LIST_ROWS)
+//
+void king_list_page(int top, int count, char names[][20])
+{
+int i;
+int y;
+int half;
+char num_buff[7];
+
+   half = (top / LIST_ROWS) % LIST_PAGES;
+
+   if (list_half_top[half] != top)
+   {
+      for (i = top; i < (top + LIST_ROWS); i++)
+      {
+         y = (half * LIST_PAGE_LINES) + ((i - top) * LIST_ROW_LINES);
+
+         printsjis("                    ", 3, y);
+
+         if (i < count)
+         {
+            sprintf(num_buff, "%2d", i + 1);
+            printsjis(num_buff, 3, y);
+            printsjis(names[i], 6, y);
+         }
+      }
+      list_half_top[half] = top;
+   }
+
+   list_scroll_y = ((half * LIST_PAGE_LINES) - LIST_TOP_LINE) & (KING_BG0_LINES - 1);
+}
+
+void king_list_end(void)
+{
+   list_shown = 0;
+   eris_king_set_scroll(KING_BG0, 0, 0);
+   king_kram_fill(0, 0, KRAM_LINE * KING_BG0_LINES);
+}
+
 void buff_listing(void)
 {
 // int i, j;
@@ -427,7 +717,6 @@ void buff_listing(void)
 // int page;
  int page_entries;
  int breakout;
- char num_buff[7];
 
    vsync(2);
 
@@ -438,11 +727,20 @@ void buff_listing(void)
       print_at(4, INSTRUCT_LINE + 1, 4, "Note: Use the up/down keys to");
       print_at(4, INSTRUCT_LINE + 2, 4, "      page forward/backward");
 
+      listing_action = 0;
+      if (menu_B == 0)
+         print_at(4, INSTRUCT_LINE + 3, 4, "      SELECT to defragment");
+
       print_at(4, STAT_LINE + 2, 5, "File");
       print_at(4, STAT_LINE + 3, 5, "----");
 
       print_at(11, STAT_LINE + 2, 5, "Name");
-      print_at( 9, STAT_LINE + 3, 5, "-----------------------");
+      print_at( 9, STAT_LINE + 3, 5, "--------------");
+
+      print_at(24, STAT_LINE + 2, 5, "Size");
+      print_at(23, STAT_LINE + 3, 5, "-----");
+      print_at(30, STAT_LINE + 2, 5, "Clus");
+      print_at(30, STAT_LINE + 3, 5, "----");
 
       print_at(36, STAT_LINE + 2, 5, "Free");
       print_at(36, STAT_LINE + 3, 5, "----");
@@ -452,6 +750,8 @@ void buff_listing(void)
       page = 0;
       breakout = 0;
 
+      king_list_begin();
+
       while (breakout == 0)
       {
          page_entries = num_dir_entries - (page * 8);
@@ -467,19 +767,18 @@ void buff_listing(void)
 //	 sprintf(num_buff, "%5d", page);
 //         print_at(33, STAT_LINE , 5,  num_buff);
 
+         king_list_page(page * 8, num_dir_entries, dir_entry);
+
          for (i = 0; i < 8; i++)
          {
             if (i >= page_entries)
             {
-               printsjis("                    ", 3, ((9 + (i * 2)) << 3) );
+               print_at(23, 9 + (i * 2), 0, "          ");
             }
 	    else
             {
-               sprintf(num_buff, "%2d", ((page * 8) + i + 1) );
-	       printsjis(num_buff, 3, ((9 + (i * 2)) << 3) );
-
-               printsjis("                 ", 6, ((9 + (i * 2)) << 3) );
-	       printsjis(dir_entry[ ((page * 8) + i) ], 6, ((9 + (i * 2)) << 3) );
+               putnumber_at(23, 9 + (i * 2), 0, 5, dir_size[ ((page * 8) + i) ]);
+               putnumber_at(29, 9 + (i * 2), 0, 4, dir_clusters[ ((page * 8) + i) ]);
             }
          }
 
@@ -501,8 +800,16 @@ void buff_listing(void)
                breakout = 1;
                break;
 	    }
+
+            if ((joytrg & JOY_SELECT) && (menu_B == 0)) {
+               listing_action = 1;
+               breakout = 1;
+               break;
+	    }
 	 }
       }
+
+      king_list_end();
    }
    else
    {
@@ -510,77 +817,397 @@ void buff_listing(void)
 
       while (1)   // wait for exit keys
       {
+         vsync(0);
+
          if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
             break;
       }
    }
 }
 
-void check_BRAM_status()
+void print_image_source(int x, int y, int pal, int selection)
+{
+   if (selection == 0)
+   {
+      print_at(x, y, pal, "BRAM   ");
+   }
+   else
+   {
+      print_at(x, y, pal, "BANK #");
+      putnumber_at(x + 6, y, pal, 2, selection);
+   }
+}
+
+void diff_listing(void)
 {
 int i;
-//u8 * cmnt_addr;
+int page_entries;
+int breakout;
+int added, removed, changed;
 
-   banks_in_use = 0;
+   vsync(2);
 
-   for (i = 0; i < 10; i++) {
-      card_date[i] = 0x00;
-   }
+   clear_panel();
 
-   bram_formatted = is_bram_formatted();
+   print_image_source(4, INSTRUCT_LINE, 5, compare_from);
+   print_at(13, INSTRUCT_LINE, 5, "->");
+   print_image_source(16, INSTRUCT_LINE, 5, menu_B);
 
-   if (bram_formatted)
+   added = removed = changed = 0;
+   for (i = 0; i < num_diff_entries; i++)
    {
-      copy_to_buffer( bram_mem );
-      bram_free = check_buffer_free();
+      if (diff_kind[i] == DIFF_ADDED)
+         added++;
+      else if (diff_kind[i] == DIFF_REMOVED)
+         removed++;
+      else
+         changed++;
    }
-   else
-      bram_free = 0;
 
-   for (i = 0; i < MAX_SLOTS; i++)
+   print_at(4, INSTRUCT_LINE + 2, 4, "Added");
+   putnumber_at(10, INSTRUCT_LINE + 2, 4, 2, added);
+   print_at(14, INSTRUCT_LINE + 2, 3, "Removed");
+   putnumber_at(22, INSTRUCT_LINE + 2, 3, 2, removed);
+   print_at(26, INSTRUCT_LINE + 2, 5, "Changed");
+   putnumber_at(34, INSTRUCT_LINE + 2, 5, 2, changed);
+
+   print_at(4, STAT_LINE + 2, 5, "File");
+   print_at(4, STAT_LINE + 3, 5, "----");
+   print_at(11, STAT_LINE + 2, 5, "Name");
+   print_at( 9, STAT_LINE + 3, 5, "-----------------------");
+   print_at(33, STAT_LINE + 2, 5, "Change");
+   print_at(33, STAT_LINE + 3, 5, "-------");
+
+   if (num_diff_entries == 0)
+      print_at(11, HEX_LINE + 1, 0, "Contents are identical");
+
+   page = 0;
+   breakout = 0;
+
+   king_list_begin();
+
+   while (breakout == 0)
    {
-      flash_formatted[i] = is_formatted( calc_bank_addr(i) ); // need to calculate offset
+      page_entries = num_diff_entries - (page * 8);
+      if (page_entries > 8)
+         page_entries = 8;
 
-      if (flash_formatted[i]) {
-         banks_in_use++;
+      king_list_page(page * 8, num_diff_entries, diff_name);
 
-	 // get reference to annotation to get date
-         copy_annotate_to_buffer( calc_bank_annotate_addr(i) );
+      for (i = 0; i < 8; i++)
+      {
+         if (i >= page_entries)
+         {
+            print_at(33, 9 + (i * 2), 0, "       ");
+         }
+         else
+         {
+            if (diff_kind[(page * 8) + i] == DIFF_ADDED)
+               print_at(33, 9 + (i * 2), 4, "ADDED  ");
+            else if (diff_kind[(page * 8) + i] == DIFF_REMOVED)
+               print_at(33, 9 + (i * 2), 3, "REMOVED");
+            else
+               print_at(33, 9 + (i * 2), 5, "CHANGED");
+         }
+      }
 
-	 //cmnt_addr = calc_bank_annotate_addr(i);
-         //memcpy(date, cmnt_addr, 11);
+      while (1)   // wait for keys - page up/down or exit
+      {
+         vsync(0);
 
-         if ( ((date_buf[0] == '1') || (date_buf[0] == '2')) )
-	 {
-            if ((strcmp(card_date, date_buf) < 0))
-            {
-               memcpy(card_date, date_buf, 10);
-            }
+         if ((joytrg & JOY_DOWN) && (num_diff_entries > ((page+1) * 8))) {
+            page++;
+            break;
+         }
+
+         if ((joytrg & JOY_UP) && (page > 0)) {
+            page--;
+            break;
+         }
+
+         if ((joytrg & JOY_RUN) || (joytrg & JOY_II)) {
+            breakout = 1;
+            break;
          }
       }
    }
-}
 
-void clear_errors(void)
-{
-   print_at(5, INSTRUCT_LINE+1, 0, "                                       ");
-   print_at(5, INSTRUCT_LINE+2, 0, "                                       ");
-   print_at(5, INSTRUCT_LINE+3, 0, "                                       ");
+   king_list_end();
 }
 
-void top_menu(void)
+void find_game_results(int entry)
 {
-static int menu_selection;
-//char tempbuf[16];
-//int i;
+int slot;
+int line;
 
    vsync(2);
 
    clear_panel();
+   clear_buff_listing();
 
-   menu_selection = 1;
+   print_at(4, INSTRUCT_LINE + 1, 5, "Game:");
+   printsjis(index_name[entry], 10, (INSTRUCT_LINE + 1) << 3);
 
-   print_at(7, HEX_LINE+10, 5, "PC-FX:");
+   print_at(2, HEX_LINE-2, 5, "Bank");
+   print_at(2, HEX_LINE-1, 5, "----");
+   print_at(7, HEX_LINE-2, 5, "Save Date");
+   print_at(7, HEX_LINE-1, 5, "----------");
+   print_at(25, HEX_LINE-2, 5, "Name");
+   print_at(24, HEX_LINE-1, 5, "------------------");
+
+   line = 0;
+
+   for (slot = 0; slot < MAX_SLOTS; slot++)
+   {
+      if ((index_slots[entry] & (1 << slot)) == 0)
+         continue;
+
+      copy_annotate_to_buffer( calc_bank_annotate_addr(slot) );
+      date_buf[10] = '\0';
+      comment_buf[COMMENT_LENGTH] = '\0';
+
+      putnumber_at(3, HEX_LINE+line, 0, 2, slot + 1);
+
+      if ((date_buf[0] != '1') && (date_buf[0] != '2'))
+         print_at(7, HEX_LINE+line, 2, "Not Set");
+      else
+         print_at(7, HEX_LINE+line, 0, date_buf);
+
+      print_at(24, HEX_LINE+line, 0, comment_buf);
+      line++;
+   }
+
+   while (1)   // wait for exit keys
+   {
+      vsync(0);
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_II) || (joytrg & JOY_I))
+         break;
+   }
+
+   printsjis("                 ", 10, (INSTRUCT_LINE + 1) << 3);
+   clear_panel();
+}
+
+void find_game_header(void)
+{
+   print_at(4, INSTRUCT_LINE + 1, 4, "Select a game to find the banks");
+   print_at(4, INSTRUCT_LINE + 2, 4, "which hold a save for it");
+
+   print_at(4, STAT_LINE + 2, 5, "File");
+   print_at(4, STAT_LINE + 3, 5, "----");
+   print_at(11, STAT_LINE + 2, 5, "Name");
+   print_at( 9, STAT_LINE + 3, 5, "-----------------------");
+}
+
+void find_game_menu(void)
+{
+int i;
+int selection;
+int refresh;
+
+   vsync(2);
+
+   clear_panel();
+   find_game_header();
+
+   selection = 0;
+   refresh = 1;
+
+   king_list_begin();
+
+   while (1)
+   {
+      page = selection / 8;
+
+      if (refresh)
+      {
+         king_list_page(page * 8, index_count, index_name);
+         refresh = 0;
+      }
+
+      for (i = 0; i < 8; i++)
+      {
+         putch_at(2, 9 + (i * 2), 4, (((page * 8) + i) == selection) ? '>' : ' ');
+      }
+
+      vsync(0);
+
+      if ((joytrg & JOY_DOWN) && (selection < (index_count - 1))) {
+         selection++;
+         if ((selection % 8) == 0)
+            refresh = 1;
+      }
+
+      if ((joytrg & JOY_UP) && (selection > 0)) {
+         selection--;
+         if ((selection % 8) == 7)
+            refresh = 1;
+      }
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_I)) {
+         king_list_end();       /* results are printed outside the list window */
+         find_game_results(selection);
+         find_game_header();
+         king_list_begin();
+         refresh = 1;
+      }
+
+      if (joytrg & JOY_II)
+         break;
+   }
+
+   for (i = 0; i < 8; i++)
+   {
+      putch_at(2, 9 + (i * 2), 0, ' ');
+   }
+   king_list_end();
+}
+
+void check_BRAM_status()
+{
+int i;
+//u8 * cmnt_addr;
+
+   banks_in_use = 0;
+
+   for (i = 0; i < 10; i++) {
+      card_date[i] = 0x00;
+   }
+
+   bram_formatted = is_bram_formatted();
+
+   index_clear();
+   memset(slot_cached, 0, sizeof(slot_cached));
+
+   if (bram_formatted)
+   {
+      copy_to_buffer( bram_mem );
+      bram_free = check_buffer_free();
+   }
+   else
+      bram_free = 0;
+
+   for (i = 0; i < MAX_SLOTS; i++)
+   {
+      flash_formatted[i] = is_formatted( calc_bank_addr(i) ); // need to calculate offset
+
+      if (flash_formatted[i]) {
+         banks_in_use++;
+
+         index_load_slot(i);
+
+	 // get reference to annotation to get date
+         copy_annotate_to_buffer( calc_bank_annotate_addr(i) );
+
+	 //cmnt_addr = calc_bank_annotate_addr(i);
+         //memcpy(date, cmnt_addr, 11);
+
+         if ( ((date_buf[0] == '1') || (date_buf[0] == '2')) )
+	 {
+            if ((strcmp(card_date, date_buf) < 0))
+            {
+               memcpy(card_date, date_buf, 10);
+            }
+         }
+      }
+   }
+}
+
+void clear_errors(void)
+{
+   print_at(5, INSTRUCT_LINE+1, 0, "                                       ");
+   print_at(5, INSTRUCT_LINE+2, 0, "                                       ");
+   print_at(5, INSTRUCT_LINE+3, 0, "                                       ");
+}
+
+// a save or restore which failed its check: shown until II is pressed
+//
+void flash_error(char * msg)
+{
+   clear_errors();
+   input_flush();
+
+   print_at(6, INSTRUCT_LINE+2, 3, msg);
+   print_at(6, INSTRUCT_LINE+3, 2, "Press II to continue");
+
+   while (1)
+   {
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
+         break;
+
+      vsync(0);
+   }
+
+   clear_errors();
+}
+
+// copy the cold screens into overlay_ram, if not done already;
+// returns 0 (after showing an error) if the cart has no valid overlay
+//
+int overlay_load(void)
+{
+#ifdef USE_OVERLAYS
+static int loaded = 0;
+u8 * src;
+u32 len;
+u32 sum;
+u32 check;
+u32 i;
+
+   if (loaded)
+      return(1);
+
+   src = &fxbmp_mem[OVERLAY_FLASH << 1];   /* cart data is every second byte */
+
+   len   = src[8]  | (src[10] << 8) | (src[12] << 16) | (src[14] << 24);
+   check = src[16] | (src[18] << 8) | (src[20] << 16) | (src[22] << 24);
+
+   if ((src[0] == 'O') && (src[2] == 'V') && (src[4] == 'L') && (src[6] == 0) &&
+       (len <= OVERLAY_MAX))
+   {
+      sum = 0;
+      for (i = 0; i < len; i++)
+      {
+         overlay_ram[i] = src[(OVERLAY_HEADER + i) << 1];
+         sum += overlay_ram[i];
+      }
+
+      if (sum == check)
+      {
+         icache_clear();
+         loaded = 1;
+         return(1);
+      }
+   }
+
+   print_at(6, INSTRUCT_LINE+2, 3, "Screen not found on card !");
+   vsync(120);
+   print_at(6, INSTRUCT_LINE+2, 0, "                          ");
+   return(0);
+#else
+   return(1);
+#endif
+}
+
+const char * const top_menu_item[] = {
+   " VIEW DATA ", " SAVE TO CARD ", " RESTORE FROM CARD ", " FIND GAME ", " COMPARE "
+};
+
+void top_menu(void)
+{
+static int menu_selection;
+int i;
+//char tempbuf[16];
+//int i;
+
+   vsync(2);
+
+   clear_panel();
+
+   menu_selection = 1;
+
+   print_at(7, HEX_LINE+10, 5, "PC-FX:");
 
 // Print "PCFXSram" (if reading properly)
 //
@@ -611,6 +1238,11 @@ static int menu_selection;
       print_at(25, HEX_LINE+16, 2, card_date);
    }
 
+   for (i = 0; i < 5; i++)
+   {
+      print_at(14, STAT_LINE + 4 + (i * 2), 0, (char *) top_menu_item[i]);
+   }
+
    while(1)
    {
       // Print frame count (temporary)
@@ -623,8 +1255,6 @@ static int menu_selection;
       if (menu_selection == 1)
         clear_errors();
 
-      print_at(14, STAT_LINE + 4, ((menu_selection == 1) ? 1 : 0), " VIEW DATA ");
-
       if (menu_selection == 2) {
          if (!bram_formatted) {
             advance = 0;
@@ -635,13 +1265,37 @@ static int menu_selection;
             print_at(6, INSTRUCT_LINE+3, 0, "                                       ");
       }
 
-      print_at(14, STAT_LINE + 6, ((menu_selection == 2) ? 1 : 0), " SAVE TO CARD ");
-
       if (menu_selection == 3) {
          if (banks_in_use == 0) {
             advance = 0;
 	    print_at(7, INSTRUCT_LINE+2, 3, "Cannot restore.");
-            print_at(7, INSTRUCT_LINE+3, 3, "No banks contain backup data !");
+            print_at(7, INSTRUCT_LINE+3, 3, "No saved games found on card !");
+	 }
+	 else
+	 {
+            print_at(5, INSTRUCT_LINE+2, 0, "                                       ");
+            print_at(6, INSTRUCT_LINE+3, 0, "                                       ");
+	 }
+      }
+
+      if (menu_selection == 4) {
+         if (index_count == 0) {
+            advance = 0;
+	    print_at(7, INSTRUCT_LINE+2, 3, "Cannot find games.");
+            print_at(7, INSTRUCT_LINE+3, 3, "No saved games found on card !");
+	 }
+	 else
+	 {
+            print_at(5, INSTRUCT_LINE+2, 0, "                                       ");
+            print_at(6, INSTRUCT_LINE+3, 0, "                                       ");
+	 }
+      }
+
+      if (menu_selection == 5) {
+         if (banks_in_use == 0) {
+            advance = 0;
+	    print_at(7, INSTRUCT_LINE+2, 3, "Cannot compare.");
+            print_at(7, INSTRUCT_LINE+3, 3, "No saved games found on card !");
 	 }
 	 else
 	 {
@@ -650,12 +1304,12 @@ static int menu_selection;
 	 }
       }
 
-      print_at(14, STAT_LINE + 8, ((menu_selection == 3) ? 1 : 0), " RESTORE FROM CARD ");
+      cursor_bar(0, 14, STAT_LINE + 2 + (menu_selection * 2), strlen(top_menu_item[menu_selection - 1]));
 
       if (joytrg & JOY_UP) {
          menu_selection--;
 	 if (menu_selection == 0)
-            menu_selection = 3;
+            menu_selection = 5;
       }
 
       if (joytrg & JOY_SELECT) {
@@ -665,7 +1319,7 @@ static int menu_selection;
 
       if (joytrg & JOY_DOWN) {
          menu_selection++;
-	 if (menu_selection == 4)
+	 if (menu_selection == 6)
             menu_selection = 1;
       }
 
@@ -677,10 +1331,13 @@ static int menu_selection;
       }
 
       vsync(0);
+
+      if (boot_ticks == 0)          // first menu frame is now on screen
+         boot_ticks = ticks_now();
    }
 }
 
-int datestr_to_num(int offset, int len)
+COLD int datestr_to_num(int offset, int len)
 {
 static int retval;
 static int count;
@@ -699,7 +1356,7 @@ static int index;
    return(retval);
 }
 
-void num_to_datestr(int value, int offset, int len)
+COLD void num_to_datestr(int value, int offset, int len)
 {
 static int count;
 static int remainder;
@@ -734,7 +1391,7 @@ void normalize_date(void)
    }
 }
 
-void get_date(void)
+COLD void get_date(void)
 {
 static char refresh;
 static char disp_str[11];
@@ -779,31 +1436,32 @@ static char disp_str[11];
          num_to_datestr(month,5,2);
          num_to_datestr(day,  8,2);
 
-         print_at(14, HEX_LINE+6, ((date_level == 1) ? 1 : 0), " ");
 	 strncpy(disp_str, date, 5);
 	 disp_str[4] = 0;
-         print_at(15, HEX_LINE+6, ((date_level == 1) ? 1 : 0), disp_str);
-         print_at(19, HEX_LINE+6, ((date_level == 1) ? 1 : 0), " ");
+         print_at(15, HEX_LINE+6, 0, disp_str);
 
 	 print_at(20, HEX_LINE+6, 0, "-");
 
-	 print_at(21, HEX_LINE+6, ((date_level == 2) ? 1 : 0), " ");
 	 strncpy(disp_str, &date[5], 3);
 	 disp_str[2] = 0;
-         print_at(22, HEX_LINE+6, ((date_level == 2) ? 1 : 0), disp_str);
-	 print_at(24, HEX_LINE+6, ((date_level == 2) ? 1 : 0), " ");
+         print_at(22, HEX_LINE+6, 0, disp_str);
 
 	 print_at(25, HEX_LINE+6, 0, "-");
 
-	 print_at(26, HEX_LINE+6, ((date_level == 3) ? 1 : 0), " ");
 	 strncpy(disp_str, &date[8], 3);
 	 disp_str[2] = 0;
-         print_at(27, HEX_LINE+6, ((date_level == 3) ? 1 : 0), disp_str);
-	 print_at(29, HEX_LINE+6, ((date_level == 3) ? 1 : 0), " ");
+         print_at(27, HEX_LINE+6, 0, disp_str);
 
 	 refresh = 0;
       }
 
+      if (date_level == 1)
+         cursor_bar(0, 14, HEX_LINE+6, 6);
+      else if (date_level == 2)
+         cursor_bar(0, 21, HEX_LINE+6, 4);
+      else
+         cursor_bar(0, 26, HEX_LINE+6, 4);
+
       if (joytrg & JOY_LEFT) {
          date_level--;
 	 if (date_level < 1)
@@ -887,7 +1545,7 @@ static char disp_str[11];
 }
 
 
-void get_comment(void)
+COLD void get_comment(void)
 {
 static char refresh;
 static char current_letter;
@@ -910,6 +1568,33 @@ int i, j;
 
    print_at(11, HEX_LINE, 0, ">> __________________ <<");
 
+   /* the keyboard is drawn once; the selection is shown by a bar */
+   for (i = 0; i < 6; i++)
+   {
+      for (j = 0; j < 13; j++)
+      {
+         current_letter = letter_display[(i*13)+j];
+
+         if ((i == 5) && (j > 6)) {
+            switch(j) {
+               case 8:
+                  print_at(26, HEX_LINE+15, 0, " SPC ");
+                  break;
+               case 10:
+                  print_at(33, HEX_LINE+15, 0, " BCK ");
+                  break;
+               case 12:
+                  print_at(38, HEX_LINE+15, 0, " END ");
+                  break;
+            }
+         }
+         else
+         {
+            putch_at((j*3)+4, HEX_LINE+(i*2)+5, 0, current_letter);
+         }
+      }
+   }
+
    refresh = 1;
 
    while (1)
@@ -917,44 +1602,13 @@ int i, j;
       if (refresh)
       {
          print_at(14, HEX_LINE, 0, today_comment);
+         cursor_bar(1, comment_index+14, HEX_LINE, 1);
 
-	 putch_at(comment_index+14, HEX_LINE, 1, today_comment[comment_index]);
+         if ((y_pos == 5) && (x_pos > 6))
+            cursor_bar(0, (x_pos == 8) ? 26 : ((x_pos == 10) ? 33 : 38), HEX_LINE+15, 5);
+         else
+            cursor_bar(0, (x_pos*3)+3, HEX_LINE+(y_pos*2)+5, 3);
 
-         for (i = 0; i < 6; i++)
-	 {
-            for (j = 0; j < 13; j++)
-	    {
-               int palette;
-
-               if ((i == y_pos) && (j == x_pos))
-                  palette = 1;
-	       else
-                  palette = 0;
-
-
-               current_letter = letter_display[(i*13)+j];
-
-	       if ((i == 5) && (j > 6)) {
-                  switch(j) {
-                     case 8:
-                        print_at(26, HEX_LINE+15, palette, " SPC ");
-                        break;
-                     case 10:
-                        print_at(33, HEX_LINE+15, palette, " BCK ");
-                        break;
-                     case 12:
-                        print_at(38, HEX_LINE+15, palette, " END ");
-                        break;
-		  }
-	       }
-	       else
-	       {
-                  print_at((j*3)+3, HEX_LINE+(i*2)+5, palette, " ");
-                  putch_at((j*3)+4, HEX_LINE+(i*2)+5, palette, current_letter);
-                  print_at((j*3)+5, HEX_LINE+(i*2)+5, palette, " ");
-	       }
-	    }
-	 }
 	 refresh = 0;
       }
 
@@ -1054,255 +1708,277 @@ int i, j;
    }
 }
 
-void select_bank_menu(void)
+// read the date, comment and free space of a slot, if not already known;
+// only the metadata and the FAT are read - not the whole slot
+//
+void slot_cache_fetch(int slot)
 {
-static int menu_selection;
-static int page_size = 16;
-static int page_end;
-static int freespace;
-static int pal;
-static char bottom_limit;
-static char refresh;
 int i;
-int j;
-int q;
-//u8 * comment_addr;
-//u8 * date_addr;
-
-   vsync(2);
+u8 * source;
 
-   clear_panel();
+   if (slot_cached[slot])
+      return;
 
-   print_at(2, HEX_LINE-2, 5, "Bank");
-   print_at(2, HEX_LINE-1, 5, "----");
-   print_at(7, HEX_LINE-2, 5, "Save Date");
-   print_at(7, HEX_LINE-1, 5, "----------");
-   print_at(19, HEX_LINE-2, 5, "Free");
-   print_at(19, HEX_LINE-1, 5, "----");
-   print_at(25, HEX_LINE-2, 5, "Name");
-   print_at(24, HEX_LINE-1, 5, "------------------");
+   flash_free[slot] = 0;
+   memset(date_slot[slot], 0, 16);
+   memset(comment_slot[slot], 0, COMMENT_LENGTH + 2);
 
-   if (menu_A == 1)        /* view */
-   {
-      menu_selection = 0;  /* BRAM is eligible for selection */
-      bottom_limit = 0;
-   }
-   else if (menu_A == 2)   /* save - date and comment should  */
-   {                       /*        have been entered by now */
-      menu_selection = 1;  /* BRAM is not eligible for selection */
-      bottom_limit = 1;
+   source = calc_bank_addr(slot);
 
-      print_at(8, INSTRUCT_LINE+1, 5, ">> Select a bank to SAVE to <<");
-      print_at(28, INSTRUCT_LINE+1, 3, "SAVE");
-   }
-   else if (menu_A == 3)   /* restore */
-   {
-      menu_selection = 1;  /* BRAM is not eligible for selection */
-      bottom_limit = 1;
-   }
-   else if (menu_A == 4)   /* erase */
+   if (flash_formatted[slot])
    {
-      menu_selection = 1;  /* BRAM is not eligible for selection */
-      bottom_limit = 1;
-   }
-   refresh = 1;
+      copy_annotate_to_buffer( calc_bank_annotate_addr(slot) );
 
-   // Pre-fetch the key information about all the entries
-   //
-   for (i = 0; i < MAX_SLOTS; i++)
-   {
-      flash_free[i] = 0;
-      for (j = 0; j < 16; j++)
-      {
-         date_slot[i][j] = '\0';
-      }
-      for (j = 0; j < (COMMENT_LENGTH + 2); j++)
+      for (i = 0; i < FAT_DIR_OFFSET_32K; i++)
       {
-         comment_slot[i][j] = '\0';
+         fat_buffer[i] = *(source + (i<<1));
       }
+      flash_free[slot] = check_image_free(fat_buffer);
 
-      if (is_formatted(calc_bank_addr(i))) {
+      memcpy(date_slot[slot], date_buf, 11);
+      memcpy(comment_slot[slot], comment_buf, COMMENT_LENGTH);
+   }
 
-         copy_to_buffer( calc_bank_addr(i) );
-         copy_annotate_to_buffer( calc_bank_annotate_addr(i) );
+   slot_cached[slot] = 1;
+}
 
-         flash_free[i] = check_buffer_free();
-         for (j = 0; j < 11; j++)
-         {
-            date_slot[i][j] = date_buf[j];
-         }
-         for (j = 0; j < (COMMENT_LENGTH + 2); j++)
-         {
-            comment_slot[i][j] = comment_buf[j];
-         }
-      }
-   }
+// re-read whether a slot is formatted after it has been written or
+// erased, and drop its cached details
+//
+void slot_refresh(int slot)
+{
+   flash_formatted[slot] = is_formatted( calc_bank_addr(slot) );
+   slot_cached[slot] = 0;
+}
 
-   while(1)
+// draw one row of the bank list;
+// 'slot' is 0-relative, and shown as bank number slot+1
+//
+void draw_bank_row(int slot, int line)
+{
+int q;
+
+   slot_cache_fetch(slot);
+
+   print_at(2, line, 4, (config_fast_slot == (slot+1)) ? "*" : " ");
+   putnumber_at(3, line, 0, 2, slot+1);
+   print_at(5, line, 0, "  ");
+
+   if (flash_formatted[slot])
    {
-      if (refresh)     /* don't display everything every cycle */
+      putnumber_at(18, line, 0, 5, flash_free[slot]);
+      print_at(23, line, 0, " ");
+
+      strncpy(comment_buf, comment_slot[slot], COMMENT_LENGTH);
+
+      // show full length even when comment is short
+      for (q = strlen(comment_slot[slot]); q < COMMENT_LENGTH; q++)
       {
-         advance = 1;  /* unless otherwise stated, allow moving to next screen */
+         comment_buf[q] = ' ';
+      }
+      comment_buf[COMMENT_LENGTH] = '\0';
 
-	 page = (menu_selection-1) / 16;
+      print_at(24, line, 0, comment_buf);
+   }
+   else
+   {
+      /* no contents */
+      print_at(18, line, 2, "      Not In Use        ");
+   }
 
-	 if (menu_A != 2)
-            clear_errors();
+   if ((date_slot[slot][0] != '1') && (date_slot[slot][0] != '2')) { /* i.e. year = 19xx or 20xx */
+      /* no date set */
+      print_at(7, line, 2, "Not Set     ");
+   }
+   else {
+      print_at(7, line, 0, date_slot[slot]);
+      print_at(17, line, 0, " ");
+   }
+}
 
-         if (bram_formatted) {
-            print_at(2, HEX_LINE, ((menu_selection == 0) ? 1 : 0), "BRAM             ");
-            putnumber_at(18, HEX_LINE, ((menu_selection == 0) ? 1: 0), 5, bram_free);
-            print_at(23, HEX_LINE, ((menu_selection == 0) ? 1 : 0), "                   ");
-         }
-         else
-         {
-            if (menu_selection == 0) /* if unformatted and current selection, */
-            {                        /* disallow moving to next screen */
-               advance = 0;
-               print_at(6, INSTRUCT_LINE+1, 3, "No contents to view.");
-	    }
+void draw_bram_row(void)
+{
+   if (bram_formatted) {
+      print_at(2, HEX_LINE, 0, "BRAM             ");
+      putnumber_at(18, HEX_LINE, 0, 5, bram_free);
+      print_at(23, HEX_LINE, 0, "                   ");
+   }
+   else
+   {
+      print_at(2, HEX_LINE, 2, "BRAM Unused                              ");
+   }
+}
 
-            print_at(2, HEX_LINE, ((menu_selection == 0) ? 1 : 2), "BRAM Unused                              ");
-         }
+// The bank list shows BRAM, then a window of BANK_LIST_ROWS banks
+// starting at list_top, which scrolls one row at a time to follow the
+// selection.  Only the rows on screen are ever read from the card, and
+// moving the selection within the window only moves the selection bar
+// - so navigation does not depend on the number of slots.
+//
+void select_bank_menu(void)
+{
+static int menu_selection;
+static int last_selection;
+static int list_top;
+static int list_rows;
+static char bottom_limit;
+static char refresh;
+static char moved;
+int i;
 
+   vsync(2);
 
-	 /* note that menu selection of banks is 1-relative, */
-	 /* but flash index is 0-relative */
-         page_end = MIN(page_size, MAX_SLOTS);
+   clear_panel();
 
-         for (i = 0; i < page_end; i++)
-         {
-            if (menu_selection == ((page*page_size)+i+1) )
-               pal = 1;
-            else
-               pal = 0;
+   print_at(2, HEX_LINE-2, 5, "Bank");
+   print_at(2, HEX_LINE-1, 5, "----");
+   print_at(7, HEX_LINE-2, 5, "Save Date");
+   print_at(7, HEX_LINE-1, 5, "----------");
+   print_at(19, HEX_LINE-2, 5, "Free");
+   print_at(19, HEX_LINE-1, 5, "----");
+   print_at(25, HEX_LINE-2, 5, "Name");
+   print_at(24, HEX_LINE-1, 5, "------------------");
 
-	    for (q = 0; q < 11; q++) {
-               date_buf[q] = '\0';
-	    }
-	    for (q = 0; q < COMMENT_LENGTH + 1; q++) {
-               comment_buf[q] = '\0';
-	    }
+   if (menu_A == 1)        /* view */
+   {
+      menu_selection = 0;  /* BRAM is eligible for selection */
+      bottom_limit = 0;
+   }
+   else if (menu_A == 2)   /* save - date and comment should  */
+   {                       /*        have been entered by now */
+      menu_selection = 1;  /* BRAM is not eligible for selection */
+      bottom_limit = 1;
 
-            if (is_formatted(calc_bank_addr(i))) {
+      print_at(8, INSTRUCT_LINE+1, 5, ">> Select a bank to SAVE to <<");
+      print_at(28, INSTRUCT_LINE+1, 3, "SAVE");
+   }
+   else if (menu_A == 3)   /* restore */
+   {
+      menu_selection = 1;  /* BRAM is not eligible for selection */
+      bottom_limit = 1;
 
-//               copy_to_buffer( calc_bank_addr(i) );
-//               copy_annotate_to_buffer( calc_bank_annotate_addr(i) );
+      print_at(4, INSTRUCT_LINE, 5, "SELECT = fast restore bank (*)");
+   }
+   else if (menu_A == 7)   /* erase (from erase_menu()) */
+   {
+      menu_selection = 1;  /* BRAM is not eligible for selection */
+      bottom_limit = 1;
+   }
+   else if (menu_A == 5)   /* compare */
+   {
+      menu_selection = 0;  /* BRAM is eligible for selection */
+      bottom_limit = 0;
 
-//               freespace = check_buffer_free();
-               freespace = flash_free[(page*page_size)+i];
-               for (j = 0; j < 11; j++)
-               {
-                  date_buf[j] = date_slot[(page*page_size)+i][j];
-               }
-               for (j = 0; j < (COMMENT_LENGTH + 2); j++)
-               {
-                  comment_buf[j] = comment_slot[(page*page_size)+i][j];
-               }
+      if (compare_stage == 1)
+         print_at(6, INSTRUCT_LINE, 5, ">> Select FIRST bank to COMPARE <<");
+      else
+         print_at(6, INSTRUCT_LINE, 5, ">> Select bank to COMPARE WITH <<");
+   }
 
-               print_at(2, HEX_LINE+1+i, pal, " ");
-               putnumber_at(3, HEX_LINE+1+i, pal, 2, (page*page_size)+i+1);
-               print_at(5, HEX_LINE+1+i, pal, "  ");
+   list_rows = MIN(BANK_LIST_ROWS, MAX_SLOTS);
+   list_top = 0;
+   last_selection = menu_selection;
+   refresh = 1;
 
-               putnumber_at(18, HEX_LINE+1+i, pal, 5, freespace);
-               print_at(23, HEX_LINE+1+i, pal, " ");
+   while(1)
+   {
+      /* note that menu selection of banks is 1-relative, */
+      /* but flash index is 0-relative */
 
-               date_buf[11] = '\0';
+      moved = refresh;
 
-	       // show full length even when comment is short
-               if (strlen(comment_buf) < COMMENT_LENGTH)
-               {
-                  for (q = strlen(comment_buf); q < COMMENT_LENGTH; q++)
-                  {
-                     comment_buf[q] = ' ';
-                  }
-               }
+      if ((menu_selection > 0) && ((menu_selection - 1) < list_top))
+      {
+         list_top = menu_selection - 1;
+         moved = 1;
+      }
+      else if ((menu_selection - 1) >= (list_top + list_rows))
+      {
+         list_top = menu_selection - list_rows;
+         moved = 1;
+      }
 
-               comment_buf[COMMENT_LENGTH] = '\0';
+      if (refresh)
+      {
+         draw_bram_row();
+      }
 
-               print_at(24, HEX_LINE+1+i, pal, comment_buf);
+      if (moved)       /* whole window */
+      {
+         for (i = 0; i < list_rows; i++)
+            draw_bank_row(list_top + i, HEX_LINE+1+i);
+      }
 
-            }
-            else
-            {
-	       /* no contents */
-               print_at(2, HEX_LINE+1+i, pal, " ");
-               putnumber_at(3, HEX_LINE+1+i, pal, 2, (page*page_size)+i+1);
-               print_at(5, HEX_LINE+1+i, pal, "  ");
+      if (menu_selection == 0)
+         cursor_bar(0, 2, HEX_LINE, 22);      /* Bank, Save Date and Free columns */
+      else
+         cursor_bar(0, 2, HEX_LINE + menu_selection - list_top, 22);
 
-               if (menu_selection != ((page*page_size)+i+1))
-               {
-                  print_at(18, HEX_LINE+1+i, 2, "      Not In Use        ");
-               }
-	       else
-               {
-                  print_at(18, HEX_LINE+1+i, pal, "      Not In Use        ");
+      refresh = 0;
 
-		  if (menu_A == 1)
-                  {
-                     advance = 0;
-                     print_at(6, INSTRUCT_LINE+1, 3, "No contents to view.");
-		  }
-		  else if (menu_A == 3)
-                  {
-                     advance = 0;
-                     print_at(6, INSTRUCT_LINE+1, 3, "No contents to restore.");
-		  }
-		  else if (menu_A == 4)
-                  {
-                     advance = 0;
-                     print_at(6, INSTRUCT_LINE+1, 3, "No contents to erase. ");
-		  }
-               }
-            }
+      if (menu_selection != last_selection)
+      {
+         if (menu_A != 2)
+            clear_errors();
+      }
+      last_selection = menu_selection;
 
-            if ((date_buf[0] != '1') && (date_buf[0] != '2')) { /* i.e. year = 19xx or 20xx */
-               /* no date set */
-               if (menu_selection != ((page*page_size)+i+1))
-               {
-                  print_at(7, HEX_LINE+1+i, 2, "Not Set     ");
-               }
-	       else
-                  print_at(7, HEX_LINE+1+i, pal, "Not Set     ");
-            }
-            else {
-               print_at(7, HEX_LINE+1+i, pal, date_buf);
-               print_at(17, HEX_LINE+1+i, pal, " ");
-            }
+      advance = 1;  /* unless otherwise stated, allow moving to next screen */
+
+      if (menu_selection == 0)
+      {
+         if (!bram_formatted) /* if unformatted and current selection, */
+         {                    /* disallow moving to next screen */
+            advance = 0;
+            print_at(6, INSTRUCT_LINE+1, 3, "No contents to view.");
+         }
+      }
+      else if (!flash_formatted[menu_selection - 1])
+      {
+         if (menu_A == 1)
+         {
+            advance = 0;
+            print_at(6, INSTRUCT_LINE+1, 3, "No contents to view.");
+         }
+         else if (menu_A == 3)
+         {
+            advance = 0;
+            print_at(6, INSTRUCT_LINE+1, 3, "No contents to restore.");
+         }
+         else if (menu_A == 7)
+         {
+            advance = 0;
+            print_at(6, INSTRUCT_LINE+1, 3, "No contents to erase. ");
+         }
+         else if (menu_A == 5)
+         {
+            advance = 0;
+            print_at(6, INSTRUCT_LINE+1, 3, "No contents to compare.");
          }
-	 refresh = 0;
       }
 
       if (joytrg & JOY_UP) {
          menu_selection--;
 	 if (menu_selection < bottom_limit)
-            menu_selection = page_end;
-
-	 refresh = 1;
+            menu_selection = MAX_SLOTS;
       }
 
       if (joytrg & JOY_DOWN) {
          menu_selection++;
-	 if (menu_selection > page_end)
+	 if (menu_selection > MAX_SLOTS)
             menu_selection = bottom_limit;
-
-	 refresh = 1;
       }
 
       if (joytrg & JOY_LEFT) {
          if (menu_selection > bottom_limit) {
             menu_selection = bottom_limit;
          }
-
-	 refresh = 1;
       }
 
       if (joytrg & JOY_RIGHT) {
-         if (menu_selection < page_end) {
-            menu_selection = page_end;
+         if (menu_selection < MAX_SLOTS) {
+            menu_selection = MAX_SLOTS;
          }
-
-	 refresh = 1;
       }
 
       if ((advance == 1) &&
@@ -1318,6 +1994,20 @@ int q;
 	 break;
       }
 
+      if ((menu_A == 3) && (joytrg & JOY_SELECT) &&
+          (menu_selection > 0) && flash_formatted[menu_selection - 1])
+      {
+         /* mark (or unmark) this bank for restore at boot */
+         if (config_fast_slot == menu_selection)
+            config_fast_slot = 0;
+         else
+            config_fast_slot = menu_selection;
+
+         config_save();
+
+         refresh = 1;       /* redraw the markers */
+      }
+
       vsync(0);
    }
 }
@@ -1331,6 +2021,7 @@ static int confirm_value;
    vsync(2);
 
    clear_panel();
+   input_flush();
 
    if (menu_A == 2)
    {
@@ -1349,7 +2040,7 @@ static int confirm_value;
       putnumber_at(26, HEX_LINE+3, 4, 2, menu_B);
       print_at(13, HEX_LINE+5, 4, "to Backup Memory ?");
    }
-   else if (menu_A == 4)
+   else if (menu_A == 7)
    {
       print_at(14, HEX_LINE+1, 4, "Confirm ");
       print_at(22, HEX_LINE+1, 3, "ERASE");
@@ -1357,122 +2048,627 @@ static int confirm_value;
       putnumber_at(24, HEX_LINE+3, 4, 2, menu_B);
       print_at(13, HEX_LINE+5, 4, "from Backup Memory ?");
    }
+   else if (menu_A == 6)
+   {
+      print_at(12, HEX_LINE+1, 4, "Confirm ");
+      print_at(20, HEX_LINE+1, 3, "DEFRAGMENT");
+      print_at(13, HEX_LINE+3, 4, "of Backup Memory ?");
+   }
+
+   print_at(16, HEX_LINE+9, 0, " YES ");
+   print_at(21, HEX_LINE+9, 0, " / ");
+   print_at(24, HEX_LINE+9, 0, " NO ");
+
+   while (1)
+   {
+      if (confirm_value == 1)
+         cursor_bar(0, 16, HEX_LINE+9, 5);
+      else
+         cursor_bar(0, 24, HEX_LINE+9, 4);
+
+      if (joytrg & JOY_LEFT)
+      {
+         confirm_value = (confirm_value == 0) ? 1 : 0;
+      }
+
+      if (joytrg & JOY_RIGHT)
+      {
+         confirm_value = (confirm_value == 0) ? 1 : 0;
+      }
+
+
+      if (joytrg & JOY_II)
+      {
+         confirm = 0;
+	 break;
+      }
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+      {
+         confirm = confirm_value;
+	 break;
+      }
+
+      vsync(0);
+   }
+}
+
+// Report the problems found by fsck_buffer() and ask whether to repair
+// them before the image is saved or restored.
+// fsck_choice is set to 0 (cancel), 1 (use as-is) or 2 (repair).
+//
+void fsck_menu(void)
+{
+static int menu_selection;
+
+   vsync(2);
+
+   clear_panel();
+
+   input_flush();
+
+   print_at(9, HEX_LINE-2, 3, "Backup data has errors !");
+
+   print_at(9, HEX_LINE+1, 4, "Cross-linked chains");
+   putnumber_at(30, HEX_LINE+1, 4, 4, fsck_cross_linked);
+   print_at(9, HEX_LINE+2, 4, "Out-of-range chains");
+   putnumber_at(30, HEX_LINE+2, 4, 4, fsck_out_of_range);
+   print_at(9, HEX_LINE+3, 4, "Orphaned clusters");
+   putnumber_at(30, HEX_LINE+3, 4, 4, fsck_orphaned);
+   print_at(9, HEX_LINE+4, 4, "Bad directory entries");
+   putnumber_at(30, HEX_LINE+4, 4, 4, fsck_bad_entries);
+
+   if (fsck_lost_files)
+   {
+      print_at(9, HEX_LINE+6, 3, "REPAIR deletes");
+      putnumber_at(24, HEX_LINE+6, 3, 2, fsck_lost_files);
+      print_at(27, HEX_LINE+6, 3, "file(s)");
+   }
+
+   print_at(9,  HEX_LINE+8, 0, " REPAIR ");
+   print_at(18, HEX_LINE+8, 0, " AS-IS ");
+   print_at(26, HEX_LINE+8, 0, " CANCEL ");
+
+   menu_selection = 2;
+
+   while (1)
+   {
+      if (menu_selection == 2)
+         cursor_bar(0, 9, HEX_LINE+8, 8);
+      else if (menu_selection == 1)
+         cursor_bar(0, 18, HEX_LINE+8, 7);
+      else
+         cursor_bar(0, 26, HEX_LINE+8, 8);
+
+      if (joytrg & JOY_LEFT)
+      {
+         menu_selection++;
+         if (menu_selection > 2)
+            menu_selection = 0;
+      }
+
+      if (joytrg & JOY_RIGHT)
+      {
+         menu_selection--;
+         if (menu_selection < 0)
+            menu_selection = 2;
+      }
+
+      if (joytrg & JOY_II)
+      {
+         fsck_choice = 0;
+	 break;
+      }
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+      {
+         fsck_choice = menu_selection;
+	 break;
+      }
+
+      vsync(0);
+   }
+}
+
+COLD void erase_menu(void)
+{
+int menu_item = 1;
+int i;
+int j;
+int failed;
+char sector_num[8];
+
+   clear_panel();
+   while (1)
+   {
+      print_at(12, STAT_LINE + 4, 0, " ERASE BOOT SECTOR  ");
+      print_at(12, STAT_LINE + 6, 0, " ERASE SINGLE ENTRY ");
+      print_at(12, STAT_LINE + 8, 0, " ERASE ENTIRE CART  ");
+      cursor_bar(0, 12, STAT_LINE + 2 + (menu_item * 2), 20);
+
+      if (joytrg & JOY_UP) {
+         menu_item--;
+	 if (menu_item == 0)
+            menu_item = 3;
+      }
+
+      if (joytrg & JOY_DOWN) {
+         menu_item++;
+	 if (menu_item == 4)
+            menu_item = 1;
+      }
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+      {
+         if (menu_item == 1)
+	 {
+	    failed = flash_erase( (u8 *) FXBMP_BASE);
+	    telemetry_flush();
+	    print_at(7, INSTRUCT_LINE+2, 3, failed ? "Erase FAILED       " : "Sector Erased      ");
+	 }
+	 else if (menu_item == 2)
+	 {
+            menu_A = 7;
+            select_bank_menu();
+
+            if (menu_B == -1)
+               continue;
+            else
+            {
+               confirm_menu();
+               if (confirm == 1)
+	       {
+                  failed = 0;
+                  for (j = 0; j < 9; j++)
+                  {
+                     if (flash_erase( (u8 *) ( calc_bank_addr(menu_B -1) + ((j<<1) * 4096)) ) != 0)
+                        failed++;
+                  }
+                  telemetry_flush();
+                  slot_refresh(menu_B - 1);
+                  clear_panel();
+	          print_at(7, INSTRUCT_LINE+2, 3, failed ? "Erase FAILED       " : "Entry Erased       ");
+	       }
+               else
+                  clear_panel();
+            }
+	 }
+	 else if (menu_item == 3)
+	 {
+            failed = 0;
+            for (i = 0; i < 128; i++)
+            {
+               sprintf(sector_num, "%3d", i);
+	       print_at(7, INSTRUCT_LINE+2, 3, "Erasing Sector ");
+	       print_at(22, INSTRUCT_LINE+2, 3, sector_num);
+               if (flash_erase(  (u8 *) (FXBMP_BASE + ((i<<1) * 4096)) ) != 0)
+                  failed++;
+	       vsync(0);
+            }
+            telemetry_flush();
+
+            for (i = 0; i < MAX_SLOTS; i++)
+               slot_refresh(i);
+	    print_at(7, INSTRUCT_LINE+2, 3, failed ? "Erase FAILED       " : "Cartridge Erased   ");
+	 }
+      }
+
+      if ((joytrg & JOY_II))
+      {
+         break;
+      }
+
+      vsync(0);
+   }
+}
+
+static struct telemetry health;        // telemetry_screen() only; too large for the stack
+
+// show the flash chip's wear and health record (see telemetry.h)
+//
+COLD void telemetry_screen(void)
+{
+int records;
+int total;
+int worn;
+int i;
+char line[48];
+
+   clear_panel();
+   records = telemetry_read(&health);
+
+   print_at(13, INSTRUCT_LINE, 5, "FLASH CHIP HEALTH");
+
+   if (records < 0)
+   {
+      print_at(5, STAT_LINE + 2, 3, "No health record on this cart");
+   }
+   else
+   {
+      total = 0;
+      worn = 0;
+      for (i = 0; i < FLASH_SECTORS; i++)
+      {
+         total += health.erase_count[i];
+         if (health.erase_count[i] > health.erase_count[worn])
+            worn = i;
+      }
+
+      sprintf(line, "Erases: %-7d Records: %d", total, records);
+      print_at(4, STAT_LINE, 0, line);
+      sprintf(line, "Most worn: sector %3d, %d erases", worn, (int) health.erase_count[worn]);
+      print_at(4, STAT_LINE + 1, 0, line);
+
+      print_at(4, STAT_LINE + 3, 4, "Erase time        Program time");
+      for (i = 0; i < TELEMETRY_BUCKETS; i++)
+      {
+         sprintf(line, "%4dms+ %7d   %4dus+ %7d",
+                 erase_bucket_ms[i], (int) health.erase_hist[i],
+                 program_bucket_us[i], (int) health.program_hist[i]);
+         print_at(4, STAT_LINE + 4 + i, 0, line);
+      }
+
+      sprintf(line, "Timeouts: %d erase, %d byte",
+              (int) health.erase_timeouts, (int) health.program_timeouts);
+      print_at(4, STAT_LINE + 13, (health.erase_timeouts || health.program_timeouts) ? 3 : 0, line);
+      sprintf(line, "Bad CRCs: %-6d Compactions: %d",
+              (int) health.verify_failures, (int) health.compactions);
+      print_at(4, STAT_LINE + 14, health.verify_failures ? 3 : 0, line);
+   }
+
+   print_at(4, HEX_LINE + 15, 2, "Press II to return");
+
+   while (1)
+   {
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
+	 break;
+
+      vsync(0);
+   }
+}
+
+// flash chips which the cart's programming sequences work with
+//
+struct chip_geometry
+{
+   u8   device;
+   char name[12];
+   int  sectors;        // of FLASH_SECTOR_SIZE bytes
+};
+
+static const struct chip_geometry chip_table[] = {
+   { 0xB5, "SST39SF010A",  32 },
+   { 0xB6, "SST39SF020A",  64 },
+   { 0xB7, "SST39SF040",  128 },
+};
+
+#define DIAG_SLOW_ERASE_MS    25          // datasheet maximum sector erase time
+#define DIAG_SLOW_PROGRAM_US  20          // datasheet maximum byte program time
+
+#define DIAG_RETRIES          2           // attempts to put back a sector which failed
+
+#define DIAG_OK         0
+#define DIAG_SLOW       1
+#define DIAG_FAILED     2
+#define DIAG_UNTESTED   3
+
+static u8  diag_copy[FLASH_SECTOR_SIZE];  // contents of the sector under test
+static u8  diag_map[FLASH_SECTORS];
+
+// erase 'sector' and program diag_copy back into it;
+// returns 0 if it then reads back correctly
+//
+static int diag_rewrite(u8 * sector)
+{
+int j;
+int bad = 0;
+
+   if (flash_erase(sector) != 0)
+      bad++;
+
+   for (j = 0; j < FLASH_SECTOR_SIZE; j++)
+   {
+      if ((diag_copy[j] != 0xFF) && (flash_write(sector + (j << 1), diag_copy[j]) != 0))
+         bad++;
+   }
+
+   for (j = 0; j < FLASH_SECTOR_SIZE; j++)
+   {
+      if (sector[j << 1] != diag_copy[j])
+         bad++;
+   }
+
+   return(bad);
+}
+
+// what the cart keeps in sector 'i', for reporting one which failed
+//
+static void diag_area(int i, char * buf)
+{
+u32 offset = i * FLASH_SECTOR_SIZE;
+
+   if (offset >= FLASH_BANK_BASE)
+      sprintf(buf, "BANK #%d", (int) ((offset - FLASH_BANK_BASE) / FLASH_BANK_SIZE) + 1);
+   else if (offset >= TELEMETRY_FLASH)
+      strcpy(buf, "health record");
+   else if (offset >= CONFIG_FLASH)
+      strcpy(buf, "settings");
+   else if (offset >= OVERLAY_FLASH)
+      strcpy(buf, "overlay");
+   else if (offset > 0)
+      strcpy(buf, "program");
+   else
+      strcpy(buf, "boot sector");
+}
+
+// 'ticks' spent on 'count' operations, as tenths of a microsecond each
+// (kept within 32 bits for any count up to a whole chip)
+//
+static int ticks_to_tenth_us(u32 ticks, u32 count)
+{
+u32 hundredths;
+
+   if (count == 0)
+      return(0);
+
+   hundredths = ((ticks / count) * 100) + (((ticks % count) * 100) / count);
+   return((hundredths * 10000) / (TIMER_TICKS_PER_MS * 100));
+}
+
+// measure the inserted cart: read speed through the bus window, then
+// each sector in turn is copied to RAM, erased (timed and checked blank),
+// and programmed back (timed and read back) - so the contents survive,
+// unless the power fails while a sector is being tested.  The size is
+// taken from the chip's ID, and a chip not in chip_table is not tested.
+// A sector which fails is put back from diag_copy (up to DIAG_RETRIES
+// times), and the pass stops there, naming what the sector holds
+//
+// (not COLD: it would not fit in the overlay alongside the other screens)
+//
+void diagnostics_screen(void)
+{
+const struct chip_geometry * chip = 0;
+volatile u8 * src;
+u8 * sector;
+u32 start;
+u32 ticks;
+u32 sum;
+u32 erase_ticks;
+u32 erase_min = 0xFFFFFFFF;
+u32 erase_max = 0;
+u32 erase_total = 0;
+u32 program_ticks = 0;
+u32 program_bytes = 0;
+u32 sector_bytes;
+int timeouts;
+int slowest = 0;
+int failed = 0;
+int slow = 0;
+int tested;
+int retries;
+int i, j;
+char line[48];
+char area[24];
+
+   clear_panel();
+   input_flush();
+
+   print_at(13, INSTRUCT_LINE, 5, "CART DIAGNOSTICS");
+
+   flash_id(&chip_id[0]);
+   for (i = 0; i < sizeof(chip_table) / sizeof(chip_table[0]); i++)
+   {
+      if ((chip_id[0] == 0xBF) && (chip_id[1] == chip_table[i].device))
+         chip = &chip_table[i];
+   }
+
+   sprintf(line, "Chip: %2.2X %2.2X  %s", chip_id[0], chip_id[1], chip ? chip->name : "unknown");
+   print_at(4, STAT_LINE, 0, line);
+   if (chip)
+   {
+      sprintf(line, "Size: %dKB, %d sectors of 4KB",
+              (chip->sectors * FLASH_SECTOR_SIZE) >> 10, chip->sectors);
+      print_at(4, STAT_LINE + 1, 0, line);
+   }
+   else
+   {
+      // the size and sector count are not known, so nothing is erased
+      print_at(4, STAT_LINE + 3, 3, "Unknown chip - not tested");
+      print_at(4, HEX_LINE + 15, 2, "Press II to return");
+
+      while (1)
+      {
+         if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
+            return;
+
+         vsync(0);
+      }
+   }
+
+   print_at(4, STAT_LINE + 3, 4, "Every sector is erased and written");
+   print_at(4, STAT_LINE + 4, 4, "back; do not switch off meanwhile.");
+   print_at(4, STAT_LINE + 5, 4, "Uses one erase cycle of each sector.");
+   print_at(4, HEX_LINE + 15, 2, "I to start, II to return");
+
+   while (1)
+   {
+      if (joytrg & JOY_II)
+         return;
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+         break;
+
+      vsync(0);
+   }
 
-   while (1)
+   print_at(4, STAT_LINE + 3, 0, "                                    ");
+   print_at(4, STAT_LINE + 4, 0, "                                    ");
+   print_at(4, STAT_LINE + 5, 0, "                                    ");
+   print_at(4, HEX_LINE + 15, 2, "                        ");
+
+   for (i = 0; i < FLASH_SECTORS; i++)
+      diag_map[i] = DIAG_UNTESTED;
+
+   // sequential read of the whole chip
+   //
+   src = (volatile u8 *) fxbmp_mem;
+   sum = 0;
+   start = ticks_now();
+   for (i = 0; i < chip->sectors * FLASH_SECTOR_SIZE; i++)
+      sum += src[i << 1];
+   ticks = ticks_now() - start;
+
+   sprintf(line, "Read: %d KB/s",
+           (int) ((((u32) (chip->sectors * FLASH_SECTOR_SIZE) >> 10) * 1000 * TIMER_TICKS_PER_MS) / ticks));
+   print_at(4, STAT_LINE + 2, 0, line);
+
+   tested = 0;
+
+   for (i = 0; i < chip->sectors; i++)
    {
-      print_at(16, HEX_LINE+9, ((confirm_value == 1) ? 1 : 0), " YES ");
-      print_at(21, HEX_LINE+9, 0, " / ");
-      print_at(24, HEX_LINE+9, ((confirm_value == 0) ? 1 : 0), " NO ");
+      sprintf(line, "Testing sector %3d", i);
+      print_at(4, STAT_LINE + 4, 3, line);
+      vsync(0);
 
-      if (joytrg & JOY_LEFT)
+      sector = fxbmp_mem + ((i * FLASH_SECTOR_SIZE) << 1);
+      diag_map[i] = DIAG_OK;
+
+      for (j = 0; j < FLASH_SECTOR_SIZE; j++)
+         diag_copy[j] = sector[j << 1];
+
+      start = ticks_now();
+      if (flash_erase(sector) != 0)
+         diag_map[i] = DIAG_FAILED;
+      erase_ticks = ticks_now() - start;
+
+      for (j = 0; j < FLASH_SECTOR_SIZE; j++)
       {
-         confirm_value = (confirm_value == 0) ? 1 : 0;
+         if (sector[j << 1] != 0xFF)
+            diag_map[i] = DIAG_FAILED;
       }
 
-      if (joytrg & JOY_RIGHT)
+      // only the bytes which are not blank need programming
+      //
+      sector_bytes = 0;
+      timeouts = 0;
+      start = ticks_now();
+      for (j = 0; j < FLASH_SECTOR_SIZE; j++)
       {
-         confirm_value = (confirm_value == 0) ? 1 : 0;
+         if (diag_copy[j] != 0xFF)
+         {
+            if (flash_write(sector + (j << 1), diag_copy[j]) != 0)
+               timeouts++;
+            sector_bytes++;
+         }
       }
+      ticks = ticks_now() - start;
+      telemetry_program(sector_bytes, ticks, timeouts);
 
+      if (timeouts)
+         diag_map[i] = DIAG_FAILED;
 
-      if (joytrg & JOY_II)
+      for (j = 0; j < FLASH_SECTOR_SIZE; j++)
       {
-         confirm = 0;
-	 break;
+         if (sector[j << 1] != diag_copy[j])
+            diag_map[i] = DIAG_FAILED;
       }
 
-      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+      if ((diag_map[i] == DIAG_OK) &&
+          ((erase_ticks > (DIAG_SLOW_ERASE_MS * TIMER_TICKS_PER_MS)) ||
+           (ticks_to_tenth_us(ticks, sector_bytes) > (DIAG_SLOW_PROGRAM_US * 10))))
+         diag_map[i] = DIAG_SLOW;
+
+      if (diag_map[i] == DIAG_FAILED)
+         failed++;
+      else if (diag_map[i] == DIAG_SLOW)
+         slow++;
+
+      tested++;
+
+      if (erase_ticks < erase_min)
+         erase_min = erase_ticks;
+      if (erase_ticks > erase_max)
       {
-         confirm = confirm_value;
-	 break;
+         erase_max = erase_ticks;
+         slowest = i;
       }
+      erase_total += erase_ticks;
+      program_ticks += ticks;
+      program_bytes += sector_bytes;
+
+      // the sector's only copy is diag_copy: put it back before going
+      // any further, and stop rather than erase another sector
+      //
+      if (diag_map[i] == DIAG_FAILED)
+      {
+         for (retries = 0; retries < DIAG_RETRIES; retries++)
+         {
+            if (diag_rewrite(sector) == 0)
+               break;
+         }
 
-      vsync(0);
+         diag_area(i, area);
+         sprintf(line, "Sector %d (%s) failed;", i, area);
+         print_at(4, STAT_LINE + 17, 3, line);
+         print_at(4, STAT_LINE + 18, 3, (retries < DIAG_RETRIES) ? "its contents were put back." :
+                                                                   "its contents could not be put back.");
+         break;
+      }
    }
-}
 
-void erase_menu(void)
-{
-int menu_item = 1;
-int i;
-int j;
-char sector_num[8];
+   telemetry_flush();
 
-   clear_panel();
-   while (1)
-   {
-      print_at(12, STAT_LINE + 4, ((menu_item == 1) ? 1 : 0), " ERASE BOOT SECTOR  ");
-      print_at(12, STAT_LINE + 6, ((menu_item == 2) ? 1 : 0), " ERASE SINGLE ENTRY ");
-      print_at(12, STAT_LINE + 8, ((menu_item == 3) ? 1 : 0), " ERASE ENTIRE CART  ");
+   j = ticks_to_tenth_us(program_ticks, program_bytes);
+   sprintf(line, "Program: %d.%d us/byte (%d bytes)", j / 10, j % 10, (int) program_bytes);
+   print_at(4, STAT_LINE + 3, 0, line);
 
-      if (joytrg & JOY_UP) {
-         menu_item--;
-	 if (menu_item == 0)
-            menu_item = 3;
-      }
+   sprintf(line, "Erase ms: %d.%d min %d.%d avg %d.%d max",
+           (int) ((erase_min * 10) / TIMER_TICKS_PER_MS) / 10, (int) ((erase_min * 10) / TIMER_TICKS_PER_MS) % 10,
+           (int) ((erase_total * 10) / (TIMER_TICKS_PER_MS * tested)) / 10,
+           (int) ((erase_total * 10) / (TIMER_TICKS_PER_MS * tested)) % 10,
+           (int) ((erase_max * 10) / TIMER_TICKS_PER_MS) / 10, (int) ((erase_max * 10) / TIMER_TICKS_PER_MS) % 10);
+   print_at(4, STAT_LINE + 4, 0, line);
 
-      if (joytrg & JOY_DOWN) {
-         menu_item++;
-	 if (menu_item == 4)
-            menu_item = 1;
-      }
+   sprintf(line, "Slowest erase: sector %d", slowest);
+   print_at(4, STAT_LINE + 5, 0, line);
 
-      if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
+   // sector map: rows of 16 sectors (8 rows for a 512KB chip)
+   //
+   for (i = 0; i < chip->sectors; i += 16)
+   {
+      putnumber_at(4, STAT_LINE + 7 + (i >> 4), 2, 4, i);
+      for (j = 0; j < 16; j++)
       {
-         if (menu_item == 1)
-	 {
-	    flash_erase_sector( (u8 *) FXBMP_BASE);
-	    print_at(7, INSTRUCT_LINE+2, 3, "Sector Erased      ");
-	 }
-	 else if (menu_item == 2)
-	 {
-            menu_A = 4;
-            select_bank_menu();
-
-            if (menu_B == -1)
-               continue;
-            else
-            {
-               confirm_menu();
-               if (confirm == 1)
-	       {
-                  for (j = 0; j < 9; j++)
-                  {
-                     flash_erase_sector( (u8 *) ( calc_bank_addr(menu_B -1) + ((j<<1) * 4096)) );
-                  }
-                  clear_panel();
-	          print_at(7, INSTRUCT_LINE+2, 3, "Entry Erased       ");
-	       }
-               else
-                  clear_panel();
-            }
-	 }
-	 else if (menu_item == 3)
-	 {
-            for (i = 0; i < 128; i++)
-            {
-               sprintf(sector_num, "%3d", i);
-	       print_at(7, INSTRUCT_LINE+2, 3, "Erasing Sector ");
-	       print_at(22, INSTRUCT_LINE+2, 3, sector_num);
-               flash_erase_sector(  (u8 *) (FXBMP_BASE + ((i<<1) * 4096)) );
-	       vsync(0);
-            }
-	    print_at(7, INSTRUCT_LINE+2, 3, "Cartridge Erased   ");
-	 }
+         if (diag_map[i + j] == DIAG_FAILED)
+            print_at(10 + j, STAT_LINE + 7 + (i >> 4), 3, "X");
+         else if (diag_map[i + j] == DIAG_SLOW)
+            print_at(10 + j, STAT_LINE + 7 + (i >> 4), 5, "s");
+         else if (diag_map[i + j] == DIAG_UNTESTED)
+            print_at(10 + j, STAT_LINE + 7 + (i >> 4), 2, "-");
+         else
+            print_at(10 + j, STAT_LINE + 7 + (i >> 4), 0, ".");
       }
+   }
 
-      if ((joytrg & JOY_II))
-      {
-         break;
-      }
+   sprintf(line, "Slow: %-4d Failed: %d", slow, failed);
+   print_at(4, STAT_LINE + 16, failed ? 3 : 0, line);
+
+   print_at(4, HEX_LINE + 15, 2, "Press II to return");
+
+   while (1)
+   {
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
+	 break;
 
       vsync(0);
    }
 }
 
-void credits(void)
+COLD void credits(void)
 {
 //int i;
+int preset;
+int changed = 0;
 
    clear_panel();
 
@@ -1489,20 +2685,57 @@ void credits(void)
 
    print_at(11, HEX_LINE+13, 0, "(c) 2022 by David Shadoff");
 
+   print_at(11, HEX_LINE+15, 2, "Startup time:");
+   putnumber_at(25, HEX_LINE+15, 2, 5, boot_ticks / TIMER_TICKS_PER_MS);
+   print_at(31, HEX_LINE+15, 2, "ms");
+
+   for (preset = REPEAT_PRESETS - 1; preset > 0; preset--)
+   {
+      if ((repeat_preset[preset][0] == repeat_delay) && (repeat_preset[preset][1] == repeat_rate))
+         break;
+   }
+
    while (1)
    {
+      print_at(8, HEX_LINE+11, 2, "Key repeat:");
+      print_at(20, HEX_LINE+11, 4, repeat_preset_name[preset]);
+      print_at(27, HEX_LINE+11, 2, "(VI)");
+
+      if (joytrg & JOY_VI)
+      {
+         preset = (preset + 1) % REPEAT_PRESETS;
+         repeat_delay = repeat_preset[preset][0];
+         repeat_rate  = repeat_preset[preset][1];
+         changed = 1;
+      }
+
       if ((joypad & 4095) == (JOY_III | JOY_IV | JOY_V | JOY_UP | JOY_SELECT) )
       {
          erase_menu();
          break;
       }
 
+      if ((joypad & 4095) == (JOY_III | JOY_IV | JOY_V | JOY_DOWN | JOY_SELECT) )
+      {
+         telemetry_screen();
+         break;
+      }
+
+      if ((joypad & 4095) == (JOY_III | JOY_IV | JOY_V | JOY_LEFT | JOY_SELECT) )
+      {
+         diagnostics_screen();
+         break;
+      }
+
       if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
 	 break;
 
       vsync(0);
    }
 
+   if (changed)
+      config_save();
+
 //   clear_panel();
 //   print_at(5, HEX_LINE+4, 0, "Erasing sectors");
 //   for (i = 0; i < 128; i++)
@@ -1514,162 +2747,88 @@ void credits(void)
 
 void init(void)
 {
-	int i, j;
-//	u32 str[256];
-	u16 microprog[16];
-	u16 a, img;
-
-	eris_low_sup_init(0);
-	eris_low_sup_init(1);
-	eris_king_init();
-	eris_tetsu_init();
-	
-	eris_tetsu_set_priorities(0, 0, 1, 0, 0, 0, 0);
-	eris_tetsu_set_7up_palette(0, 0);
-	eris_tetsu_set_king_palette(0, 0, 0, 0);
-	eris_tetsu_set_rainbow_palette(0);
-
-	eris_king_set_bg_prio(KING_BGPRIO_3, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, 0);
-	eris_king_set_bg_mode(KING_BGMODE_4_PAL, 0, 0, 0);
-	eris_king_set_kram_pages(0, 0, 0, 0);
-
-	for(i = 0; i < 16; i++) {
-		microprog[i] = KING_CODE_NOP;
-	}
+	// KING BG0 is 256 wide, KING_BG0_LINES high (see king_list_begin()),
+	// and the selection bars are 7up sprites
+	console_init(KING_BG0_LINES, 1);
 
-	microprog[0] = KING_CODE_BG0_CG_0;
-	eris_king_disable_microprogram();
-	eris_king_write_microprogram(microprog, 0, 16);
-	eris_king_enable_microprogram();
-
-	//eris_tetsu_set_palette(3, 0x602C);
-	//eris_tetsu_set_palette(4, 0x5080);
-	//eris_tetsu_set_palette(5, 0xC422);
-	//eris_tetsu_set_palette(6, 0x9999);
-	//eris_tetsu_set_palette(7, 0x1234);
-
-	/* Font uses sub-palette #1 for FG, #2 for BG */
-	/* palette #0 is default - light green background, bright white foreground */
-	eris_tetsu_set_palette(0x00, 0x2A66);
-	eris_tetsu_set_palette(0x01, 0xFC88);
-	eris_tetsu_set_palette(0x02, 0x2A66);
-
-	/* palette #1 is selection/inverse - bright white background, light green foreground */
-	eris_tetsu_set_palette(0x10, 0xFC88);
-	eris_tetsu_set_palette(0x11, 0x2A66);
-	eris_tetsu_set_palette(0x12, 0xFC88);
-
-	/* palette #2 is disabled/dimmed - light green background, dimmed white foreground */
-	eris_tetsu_set_palette(0x20, 0x2A66);
-	eris_tetsu_set_palette(0x21, 0x9088);
-	eris_tetsu_set_palette(0x22, 0x2A66);
-
-	/* palette #3 is error/red - light green background, bright red foreground */
-	eris_tetsu_set_palette(0x30, 0x2A66);
-	eris_tetsu_set_palette(0x31, 0x8B3B);  // TODO: get right RED (was 4B5F)
-	eris_tetsu_set_palette(0x32, 0x2A66);
-
-	/* palette #4 is highlight/yellow - light green background, bright yellow foreground */
-	eris_tetsu_set_palette(0x40, 0x2A66);
-	eris_tetsu_set_palette(0x41, 0xDF09);
-	eris_tetsu_set_palette(0x42, 0x2A66);
-
-	/* palette #5 is highlight/blue-green - light green background, blue-green foreground */
-	eris_tetsu_set_palette(0x50, 0x2A66);
-	eris_tetsu_set_palette(0x51, 0x9BB1);
-	eris_tetsu_set_palette(0x52, 0x2A66);
-
-
-	eris_tetsu_set_video_mode(TETSU_LINES_262, 0, TETSU_DOTCLOCK_7MHz, TETSU_COLORS_16,
-				TETSU_COLORS_16, 1, 0, 1, 0, 0, 0, 0);
-	eris_king_set_bat_cg_addr(KING_BG0, 0, 0);
-	eris_king_set_bat_cg_addr(KING_BG0SUB, 0, 0);
-	eris_king_set_scroll(KING_BG0, 0, 0);
-	eris_king_set_bg_size(KING_BG0, KING_BGSIZE_256, KING_BGSIZE_256, KING_BGSIZE_256, KING_BGSIZE_256);
-	eris_low_sup_set_control(0, 0, 1, 0);
-	eris_low_sup_set_access_width(0, 0, SUP_LOW_MAP_64X32, 0, 0);
-	eris_low_sup_set_scroll(0, 0, 0);
-	//eris_low_sup_set_video_mode(0, 2, 2, 4, 0x1F, 0x11, 2, 239, 2); // 5MHz numbers
-	eris_low_sup_set_video_mode(0, 3, 3, 6, 0x2B, 0x11, 2, 239, 2);
-
-	eris_king_set_kram_read(0, 1);
-	eris_king_set_kram_write(0, 1);
-	// Clear BG0's RAM
-	for(i = 0; i < 0x1E00; i++) {
-		eris_king_kram_write(0);
-	}
-	eris_king_set_kram_write(0, 1);
+	vsync_hook = bank_vblank;
+#ifdef PROFILE
+	frame_end_hook = prof_frame_end;
+#endif
 
-	eris_low_sup_set_vram_write(0, 0);
-	for(i = 0; i < 0x800; i++) {
-		eris_low_sup_vram_write(0, 0x120); // 0x80 is space
-	}
+	/* sprite palette #6 is the selection bar, behind the text */
+	eris_tetsu_set_palette((CURSOR_PAL << 4) + 1, CURSOR_COLOR);
 
+	glyph_cache_init();
+	crc32_init();
 
-	eris_low_sup_set_vram_write(0, 0x1200);
-	// load font into video memory
-	for(i = 0; i < 0x60; i++) {
-		// first 2 planes of color
-		for (j = 0; j < 8; j++) {
-			img = font[(i*8)+j] & 0xff;
-			a = (~img << 8) | img;
-			eris_low_sup_vram_write(0, a);
-		}
-		// last 2 planes of color
-		for (j = 0; j < 8; j++) {
-			eris_low_sup_vram_write(0, 0);
-		}
-	}
+	cursor_init();
+}
+
+void fast_restore_error(char * msg)
+{
+   print_at(6, INSTRUCT_LINE+2, 3, msg);
+   vsync(120);
+   clear_errors();
+}
 
-	eris_pad_init(0); // initialize joypad
+// Restore the fast-restore bank to BRAM without any menus, when
+// FASTBOOT_KEYS are held at boot.  The bank must match the CRC it
+// was saved with and pass fsck_buffer(), and BRAM is read back
+// afterwards.  Returns 0 when done, else -1 (having shown why).
+//
+int fast_restore(void)
+{
+int slot;
+int i;
+u32 crc;
 
-//	chartou32("7up BG example", str);
-//	printstr(str, 9, 0x10, 1);
+   print_at(12, HEX_LINE, 4, "Fast restore of BANK #");
+   putnumber_at(34, HEX_LINE, 4, 2, config_fast_slot);
+   vsync(0);
 
-//	print_at(6,  6, 0, "7up BG example");
-//	print_at(6,  7, 1, "Testing Color 1");
-//	print_at(6,  8, 2, "Testing Color 2");
-//	print_at(6,  9, 3, "Testing Color 3");
-//	print_at(6, 10, 4, "Testing Color 4");
-//	print_at(6, 11, 5, "Testing Color 5");
+   slot = config_fast_slot - 1;
 
-        // Disable all interrupts before changing handlers.
-        irq_set_mask(0x7F);
+   if ((slot < 0) || (!is_formatted( calc_bank_addr(slot) )))
+   {
+      fast_restore_error("No fast restore bank is set.");
+      return(-1);
+   }
 
-        // Replace firmware IRQ handlers for the Timer and HuC6270-A.
-        //
-        // This liberis function uses the V810's hardware IRQ numbering,
-        // see FXGA_GA and FXGABOAD documents for more info ...
-        irq_set_raw_handler(0xC, my_vblank_irq);
+   copy_to_buffer( calc_bank_addr(slot) );
 
-        // Enable Timer and HuC6270-A interrupts.
-        //
-        // d6=Timer
-        // d5=External
-        // d4=KeyPad
-        // d3=HuC6270-A
-        // d2=HuC6272
-        // d1=HuC6270-B
-        // d0=HuC6273
-        irq_set_mask(0x77);
+   if (slot_crc(slot, &crc) && (crc != crc32_buffer(bram_buffer, 32768)))
+   {
+      telemetry_verify_failure();
+      telemetry_flush();
+      fast_restore_error("Bank data is damaged !");
+      return(-1);
+   }
 
-        // Allow all IRQs.
-        //
-        // This liberis function uses the V810's hardware IRQ numbering,
-        // see FXGA_GA and FXGABOAD documents for more info ...
-        irq_set_level(8);
+   if (fsck_buffer(0) != 0)
+   {
+      fast_restore_error("Bank data has errors !");
+      return(-1);
+   }
 
-        // Enable V810 CPU's interrupt handling.
-        irq_enable();
+   buffer_to_bram();
 
-        eris_low_sup_setreg(0, 5, 0x88);  // Set Hu6270 BG to show, and VSYNC Interrupt
+   for (i = 0; i < 32768; i++)
+   {
+      if (bram_mem[(i<<1)] != bram_buffer[i])
+      {
+         fast_restore_error("BRAM did not verify !");
+         return(-1);
+      }
+   }
 
-        eris_bkupmem_set_access(1,1);  // allow read and write access to both internal and external backup memory
+   return(0);
 }
 
 int main(int argc, char *argv[])
 {
 char hexdata[8];
+u32 crc;
 
    init();
 
@@ -1699,10 +2858,25 @@ char hexdata[8];
       print_at( 8, INSTRUCT_LINE + 12, 0, "MEDIA = ");
       print_at(16, INSTRUCT_LINE + 12, 0, hexdata);
       print_at(15, INSTRUCT_LINE + 15, 0, "*** ABORT *** ");
+      bat_flush();
       while(1);
    }
 #endif
-   
+
+   config_load();
+
+   vsync(1);     /* so that the joypad has been read */
+
+   if (((joypad & FASTBOOT_KEYS) == FASTBOOT_KEYS) && (fast_restore() == 0))
+   {
+      /* there is no known way back into the firmware's boot sequence */
+      /* from here, so say that it worked and carry on to the menus   */
+      print_at(8, INSTRUCT_LINE+2, 4, "Restored - reset to start game");
+      vsync(120);
+      clear_errors();
+   }
+   print_at(12, HEX_LINE, 0, "                          ");
+
    menu_level = 1;
 
    /* determine whether each bank is actually in use, and */
@@ -1718,12 +2892,38 @@ char hexdata[8];
 
 	 if (menu_A == -1)
 	 {
-            credits();
+            if (overlay_load())
+               credits();
+            menu_level = 1;
+            continue;
+	 }
+	 else if (menu_A == 4)         /* find game */
+	 {
+            find_game_menu();
             menu_level = 1;
             continue;
 	 }
+	 else if (menu_A == 5)         /* compare - select first image here, */
+	 {                             /* second one below                   */
+            compare_stage = 1;
+            select_bank_menu();
+
+            if (menu_B == -1)
+	    {
+               menu_level = 1;
+	       continue;
+	    }
+            compare_from = menu_B;
+            compare_stage = 2;
+	 }
 	 else if (menu_A == 2)         /* save - get date, comment */
          {
+            if (!overlay_load())
+	    {
+               menu_level = 1;
+	       continue;
+	    }
+
             /* Get date information */
             get_date();
 
@@ -1773,10 +2973,44 @@ char hexdata[8];
 
             bram_free = check_buffer_free();
             get_buffer_directory();
+            get_buffer_usage();
 	    buff_listing();       /* this waits for exit keys */
 
             clear_buff_listing();
             menu_level = 2;
+
+            if (listing_action == 1)   /* defragment BRAM */
+	    {
+               menu_A = 6;
+               confirm_menu();
+               menu_A = 1;
+
+               if (confirm == 1)
+	       {
+                  if (fsck_buffer(0) != 0)
+		  {
+                     fsck_menu();       /* only a repaired image can be rearranged */
+
+                     if (fsck_choice == 2)
+                        fsck_buffer(1);
+                     else
+                        continue;
+		  }
+
+                  defrag_buffer();
+                  buffer_to_bram();
+	       }
+	    }
+         }
+         else if (menu_A == 5)    /* compare */
+         {
+            copy_image_to( bram_buffer, (compare_from == 0) ? bram_mem : calc_bank_addr(compare_from -1) );
+            copy_image_to( diff_buffer, (menu_B == 0) ? bram_mem : calc_bank_addr(menu_B -1) );
+
+            diff_images();
+            diff_listing();       /* this waits for exit keys */
+
+            menu_level = 1;
          }
          else if (menu_A == 2)    /* save */
          {
@@ -1794,7 +3028,24 @@ char hexdata[8];
                strncpy(comment, today_comment, COMMENT_LENGTH + 1);
 
                copy_to_buffer( bram_mem);
-               buffer_to_flash( calc_bank_addr(menu_B -1) );
+
+               if (fsck_buffer(0) != 0)
+	       {
+                  fsck_menu();
+
+                  if (fsck_choice == 0)
+		  {
+                     menu_level = 1;
+                     continue;
+		  }
+                  else if (fsck_choice == 2)
+                     fsck_buffer(1);
+	       }
+
+               if (buffer_to_flash( calc_bank_addr(menu_B -1), date, comment ) != 0)
+                  flash_error("Save FAILED - bank is damaged !");
+
+               slot_refresh(menu_B - 1);
 
 	       menu_level = 1;
 	    }
@@ -1812,6 +3063,29 @@ char hexdata[8];
 	    else
 	    {
                copy_to_buffer( calc_bank_addr(menu_B -1) );
+
+               if (slot_crc(menu_B - 1, &crc) && (crc != crc32_buffer(bram_buffer, 32768)))
+               {
+                  telemetry_verify_failure();
+                  telemetry_flush();
+                  flash_error("Bank data is damaged !");
+                  menu_level = 1;
+                  continue;
+               }
+
+               if (fsck_buffer(0) != 0)
+	       {
+                  fsck_menu();
+
+                  if (fsck_choice == 0)
+		  {
+                     menu_level = 1;
+                     continue;
+		  }
+                  else if (fsck_choice == 2)
+                     fsck_buffer(1);
+	       }
+
 	       buffer_to_bram();
 
 	       menu_level = 1;
@@ -1821,65 +3095,103 @@ char hexdata[8];
    }
 
    print_at(4, TITLE_LINE, 0, "oops - fatal error");
+   bat_flush();
 
    while(1);
 
    return 0;
 }
 
-// print with first 7up (HuC6270 #0)
+// load the selection bar patterns, and point the 7up at the SATB,
+// which it copies to its sprite table on every VSYNC
 //
-void print_at(int x, int y, int pal, char* str)
+void cursor_init(void)
 {
+	u16 pattern[4 * 64];
 	int i;
-	u16 a;
-
-	i = (y * 64) + x;
 
-	eris_low_sup_set_vram_write(0, i);
-	for (i = 0; i < strlen8(str); i++) {
-		a = (pal * 0x1000) + str[i] + 0x100;
-		eris_low_sup_vram_write(0, a);
+	for (i = 0; i < (4 * 64); i++) {
+		pattern[i] = 0;
 	}
-}
 
-void putch_at(int x, int y, int pal, char c)
-{
-        int i;
-        u16 a;
+	// patterns 0-2 are solid, pattern 3 only its left 8 pixels;
+	// only the top 8 lines (one text row) are set, in plane 0 (color 1)
+	for (i = 0; i < 8; i++) {
+		pattern[i]       = 0xFFFF;
+		pattern[64 + i]  = 0xFFFF;
+		pattern[128 + i] = 0xFFFF;
+		pattern[192 + i] = 0xFF00;
+	}
 
-        i = (y * 64) + x;
+	sup_vram_block(SPR_PATTERN_ADDR, pattern, 4 * 64);
+	sup_vram_fill(SATB_ADDR, 0, SATB_ENTRIES * 4);
 
-        eris_low_sup_set_vram_write(0, i);
+	for (i = 0; i < CURSOR_WORDS; i++) {
+		cursor_satb[i] = 0;
+	}
+	cursor_dirty = 0;
 
-        a = (pal * 0x1000) + c + 0x100;
-        eris_low_sup_vram_write(0, a);
+	eris_low_sup_setreg(0, SUP_REG_DCR, SUP_DCR_SATB_AUTO);
+	eris_low_sup_setreg(0, SUP_REG_DVSSR, SATB_ADDR);
 }
 
-void putnumber_at(int x, int y, int pal, int len, int value)
+// place selection bar 'bar' over 'width' characters at x, y
+// (width 0 hides it; at most CURSOR_MAX_WIDTH are covered);
+// the SATB is only rewritten if it changed
+//
+void cursor_bar(int bar, int x, int y, int width)
 {
-        int i;
-        u16 a;
-	char str[64];
-
-        i = (y * 64) + x;
+	u16 *spr;
+	u16 entry[4];
+	int i, k;
+	int w;
+
+	spr = &cursor_satb[bar * CURSOR_BAR_SPRITES * 4];
+	width = MIN(width, CURSOR_MAX_WIDTH);
+
+	for (i = 0; i < CURSOR_BAR_SPRITES; i++, spr += 4) {
+		w = MIN(width, 4);
+		width -= w;
+
+		if (w <= 0) {
+			entry[0] = 0;       // above the top of the screen
+			entry[1] = 0;
+			entry[2] = 0;
+			entry[3] = 0;
+		}
+		else {
+			entry[0] = (y << 3) + 64;
+			entry[1] = ((x + (i * 4)) << 3) + 32;
+			entry[2] = cursor_code[w];
+			entry[3] = CURSOR_PAL | ((w > 2) ? SPR_CGX_32 : 0);
+		}
 
-	if (len == 2) {
-	   sprintf(str, "%2d", value);
-	}
-	else if (len == 4) {
-	   sprintf(str, "%4d", value);
-	}
-	else if (len == 5) {
-	   sprintf(str, "%5d", value);
+		for (k = 0; k < 4; k++) {
+			if (spr[k] != entry[k]) {
+				spr[k] = entry[k];
+				cursor_dirty = 1;
+			}
+		}
 	}
+}
 
-        eris_low_sup_set_vram_write(0, i);
+void cursor_hide(void)
+{
+	int bar;
 
-	for (i = 0; i < strlen8(str); i++) {
-                a = (pal * 0x1000) + str[i] + 0x100;
-                eris_low_sup_vram_write(0, a);
-        }
+	for (bar = 0; bar < CURSOR_BARS; bar++) {
+		cursor_bar(bar, 0, 0, 0);
+	}
+}
+
+// (called from vsync(), after bat_flush())
+//
+void cursor_flush(void)
+{
+	if (cursor_dirty) {
+		sup_vram_block(SATB_ADDR, cursor_satb, CURSOR_WORDS);
+		cursor_dirty = 0;
+	}
 }
 
 // functions related to printing with KING processor
@@ -1892,6 +3204,7 @@ int offset;
 u8 ch, ch2;
 u32 sjis;
 u32 kram;
+PROF_BEGIN();
 
    offset = 0;
    kram = x + (y <<5);
@@ -1919,54 +3232,94 @@ u32 kram;
       ch = *(text+offset);
    }
 
+   PROF_END();
 }
 
-void print_narrow(u32 sjis, u32 kram)
+void glyph_cache_init(void)
 {
+        int i, x;
         u16 px;
-        int x, y;
-        u8* glyph;
-
-        glyph = eris_romfont_get(sjis, ROMFONT_ANK_8x16);
 
-        for(y = 0; y < 16; y++) {
-                eris_king_set_kram_write(kram + (y << 5), 1);
+        for(i = 0; i < 256; i++) {
                 px = 0;
                 for(x = 0; x < 8; x++) {
-                        if((glyph[y] >> x) & 1) {
+                        if((i >> x) & 1) {
                                 px |= 1 << (x << 1);
                         }
                 }
-                eris_king_kram_write(px);
+                glyph_expand[i] = px;
+        }
+
+        for(i = 0; i < GLYPH_CACHE_SIZE; i++) {
+                glyph_tag[i] = 0;
         }
 }
 
-void print_wide(u32 sjis, u32 kram)
+// return the expanded KRAM words for 'sjis', reading and
+// expanding the ROM font glyph only if it is not cached
+//
+u16 * glyph_lookup(u32 sjis)
 {
-        u16 px;
-        int x, y;
-        u16* glyph;
+        int slot;
+        int y;
+        u8* narrow;
+        u16* wide;
+        u16* words;
+
+        slot = (sjis ^ (sjis >> 5)) & (GLYPH_CACHE_SIZE - 1);
+        words = glyph_cache[slot];
+
+        if (glyph_tag[slot] == sjis)
+                return(words);
+
+        if (sjis < 0x100) {
+                narrow = eris_romfont_get(sjis, ROMFONT_ANK_8x16);
+                for(y = 0; y < GLYPH_ROWS; y++) {
+                        words[y] = glyph_expand[narrow[y]];
+                }
+        }
+        else {
+                wide = (u16*) eris_romfont_get(sjis, ROMFONT_KANJI_16x16);
+                for(y = 0; y < GLYPH_ROWS; y++) {
+                        words[y]              = glyph_expand[wide[y] & 0xff];
+                        words[y + GLYPH_ROWS] = glyph_expand[(wide[y] >> 8) & 0xff];
+                }
+        }
 
-        glyph = (u16*) eris_romfont_get(sjis, ROMFONT_KANJI_16x16);
+        glyph_tag[slot] = sjis;
+        return(words);
+}
 
-        for(y = 0; y < 16; y++) {
-                eris_king_set_kram_write(kram + (y << 5), 1);
-                px = 0;
-                for(x = 0; x < 8; x++) {
-                        if((glyph[y] >> x) & 1) {
-                                px |= 1 << (x << 1);
-                        }
-                }
-                eris_king_kram_write(px);
+// each glyph column is written with a single KRAM address set,
+// using an increment of one line
+//
+void print_narrow(u32 sjis, u32 kram)
+{
+        int y;
+        u16* words;
 
-                eris_king_set_kram_write(kram + (y << 5) + 1, 1);
-                px = 0;
-                for(x = 0; x < 8; x++) {
-                        if((glyph[y] >> (x+8)) & 1) {
-                                px |= 1 << (x << 1);
-                        }
-                }
-                eris_king_kram_write(px);
+        words = glyph_lookup(sjis);
+
+        eris_king_set_kram_write(kram, KRAM_LINE);
+        for(y = 0; y < GLYPH_ROWS; y++) {
+                eris_king_kram_write(words[y]);
         }
 }
 
+void print_wide(u32 sjis, u32 kram)
+{
+        int y;
+        u16* words;
+
+        words = glyph_lookup(sjis);
+
+        eris_king_set_kram_write(kram, KRAM_LINE);
+        for(y = 0; y < GLYPH_ROWS; y++) {
+                eris_king_kram_write(words[y]);
+        }
+
+        eris_king_set_kram_write(kram + 1, KRAM_LINE);
+        for(y = 0; y < GLYPH_ROWS; y++) {
+                eris_king_kram_write(words[y + GLYPH_ROWS]);
+        }
+}
@@ -0,0 +1,117 @@
+/*
+ * unlzss.s - Boot stub for a compressed program (see Host_Tools/mkcart.cpp)
+ *
+ * The firmware copies this stub, together with the compressed
+ * program which follows it, to high RAM and jumps to it.  The stub
+ * unpacks the program to 0x8000 (where it would have been loaded
+ * uncompressed) and jumps there.  It is position-independent.
+ *
+ * Packed data (after the stub, 4-byte aligned):
+ *   4 bytes  - unpacked length (little-endian)
+ *   LZSS stream - a flag byte, then 8 items, one per flag bit (LSB first):
+ *     1 = literal byte
+ *     0 = match: 2 bytes - low 8 bits of (distance - 1), then
+ *                          bits 7-4: bits 11-8 of (distance - 1)
+ *                          bits 3-0: length - 3
+*/
+
+#=============================
+# Macros
+#=============================
+
+.macro  movw data, reg1
+        movhi   hi(\data),r0,\reg1
+        movea   lo(\data),\reg1,\reg1
+.endm
+
+.include "icache.inc"
+
+#===============================
+
+.equiv PROGRAM_ADDR, 0x8000
+
+.equiv r_src,    r10
+.equiv r_dst,    r11
+.equiv r_end,    r12
+.equiv r_flags,  r13
+.equiv r_bits,   r14
+.equiv r_tmp,    r15
+.equiv r_len,    r16
+.equiv r_ref,    r17
+.equiv r_byte,   r18
+
+    .text
+
+_start:
+    jal  here                    # find out where we were loaded
+here:
+    mov  lp, r_src
+    movea (packed - here), r_src, r_src
+
+    ld.w 0[r_src], r_end         # unpacked length
+    add  4, r_src
+    movw PROGRAM_ADDR, r_dst
+    add  r_dst, r_end            # end of output
+
+    mov  0, r_bits               # no flag bits left
+
+unpack:
+    cmp  r_end, r_dst
+    bnl  done                    # output complete
+
+    cmp  0, r_bits
+    bne  have_flags
+    ld.b 0[r_src], r_flags       # next flag byte
+    add  1, r_src
+    movea 8, r0, r_bits
+
+have_flags:
+    add  -1, r_bits
+    andi 1, r_flags, r_tmp
+    shr  1, r_flags
+    cmp  0, r_tmp
+    be   match
+
+    ld.b 0[r_src], r_byte        # literal
+    add  1, r_src
+    st.b r_byte, 0[r_dst]
+    add  1, r_dst
+    br   unpack
+
+match:
+    ld.b 0[r_src], r_tmp
+    andi 0xFF, r_tmp, r_tmp
+    ld.b 1[r_src], r_len
+    andi 0xFF, r_len, r_len
+    add  2, r_src
+
+    mov  r_len, r_ref            # distance - 1 = high nybble : first byte
+    shr  4, r_ref
+    shl  8, r_ref
+    or   r_tmp, r_ref
+    add  1, r_ref
+
+    mov  r_dst, r_tmp            # copy from output - distance
+    sub  r_ref, r_tmp
+    mov  r_tmp, r_ref
+
+    andi 0x0F, r_len, r_len
+    add  3, r_len
+
+copy:                            # byte by byte, as a match may overlap itself
+    ld.b 0[r_ref], r_byte
+    st.b r_byte, 0[r_dst]
+    add  1, r_ref
+    add  1, r_dst
+    add  -1, r_len
+    bne  copy
+    br   unpack
+
+done:
+    icache_clear_all r_tmp       # the program is new code at those addresses
+
+    movw PROGRAM_ADDR, r_tmp
+    jmp  [r_tmp]
+
+    .balign 4
+packed:
@@ -0,0 +1,376 @@
+/*
+ *   bench.c - benchmark of the storage core against the flash chip model
+ *
+ *   Runs the cart operations of the Backup Manager (save, re-save, restore,
+ *   viewing the banks, erasing the cart) in a host build, and reports
+ *   for each the bytes read and programmed, sectors erased, command
+ *   writes and simulated time on the cart.  Only cart bus time is
+ *   simulated - not the V810's own time spent between accesses.
+ *
+ *   Results are written one line per workload, so that a later run can
+ *   be compared against them with '-compare'.
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bram.h"
+
+#define MAX_RESULTS      32
+#define SLOWER_PERCENT   0.5             // '-compare' fails a workload this much slower
+
+struct result
+{
+   char   name[32];
+   u32    bytes_read;
+   u32    bytes_programmed;
+   u32    sectors_erased;
+   u32    command_writes;
+   double sim_ms;
+};
+
+struct workload
+{
+   char * name;
+   void (*setup)(void);       // not measured
+   void (*run)(void);
+};
+
+struct result results[MAX_RESULTS];
+int num_results;
+
+char bench_date[]    = "2023-01-07";
+char bench_comment[] = "BENCHMARK         ";
+
+
+// a newly formatted 32KB backup memory: header, and an empty FAT and directory
+//
+void make_empty_image(u8 * img)
+{
+   memset(img, 0, 32768);
+   memcpy(img + 3, "PCFXSram", 8);
+
+   img[FAT_OFFSET]     = 0xF9;
+   img[FAT_OFFSET + 1] = 0xFF;
+   img[FAT_OFFSET + 2] = 0xFF;
+}
+
+// a full one: 16 files sharing every cluster, with data which does not repeat
+//
+void make_full_image(u8 * img)
+{
+int file, cluster, first, count;
+int offset;
+u32 size;
+u32 seed = 12345;
+int i;
+
+   make_empty_image(img);
+
+   cluster = FAT_FIRST_CLUSTER;
+   for (file = 0; file < 16; file++)
+   {
+      first = cluster;
+      count = (FAT_ENTRIES_32K / 16) + ((file < (FAT_ENTRIES_32K % 16)) ? 1 : 0);
+
+      offset = FAT_DIR_OFFSET_32K + (file * FAT_DIR_ENTRY_SIZE);
+      sprintf((char *) img + offset, "GAME%04d", file);
+      memcpy(img + offset + 8, "SAV", 3);
+      memcpy(img + offset + 12, "SAVEDATA", 8);
+
+      img[offset + DIR_START_CLUSTER]     = first & 0xff;
+      img[offset + DIR_START_CLUSTER + 1] = first >> 8;
+      size = count * FAT_SECTOR_SIZE;
+      memcpy(&img[offset + DIR_FILE_SIZE], &size, 4);
+
+      for (i = 0; i < count; i++, cluster++)
+         fat_set_entry(img, cluster, (i == (count - 1)) ? FAT_END_MARK : (cluster + 1));
+   }
+
+   for (i = FAT_DATA_OFFSET_32K; i < 32768; i++)
+   {
+      seed = (seed * 1103515245) + 12345;
+      img[i] = seed >> 16;
+   }
+}
+
+
+void setup_empty(void)
+{
+   make_empty_image(bram_buffer);
+}
+
+void setup_full(void)
+{
+   make_full_image(bram_buffer);
+}
+
+void setup_changed(void)
+{
+   make_full_image(bram_buffer);
+   memset(bram_buffer + FAT_DATA_OFFSET_32K + 100, 0x55, 16);
+}
+
+void setup_all_banks(void)
+{
+int slot;
+
+   make_full_image(bram_buffer);
+   for (slot = 2; slot < MAX_SLOTS; slot++)
+      buffer_to_flash(calc_bank_addr(slot), bench_date, bench_comment);
+}
+
+void run_save_slot0(void)
+{
+   buffer_to_flash(calc_bank_addr(0), bench_date, bench_comment);
+}
+
+void run_save_slot1(void)
+{
+   buffer_to_flash(calc_bank_addr(1), bench_date, bench_comment);
+}
+
+void run_restore(void)
+{
+   copy_to_buffer(calc_bank_addr(1));
+   if (fsck_buffer(0) == 0)
+      buffer_to_bram();
+}
+
+// what the bank list and FIND GAME read: date and comment,
+// then the FAT (for free space) and the directory of each slot
+//
+void run_view_all(void)
+{
+u8 fat_buffer[FAT_DIR_OFFSET_32K];
+u8 * meta;
+int slot;
+int i;
+
+   for (slot = 0; slot < MAX_SLOTS; slot++)
+   {
+      if (!is_formatted(calc_bank_addr(slot)))
+         continue;
+
+      meta = calc_bank_annotate_addr(slot);
+      for (i = 0; i < COMMENT_OFFSET + COMMENT_LENGTH; i++)
+         BUS_READ(meta + (i<<1));
+
+      for (i = 0; i < FAT_DIR_OFFSET_32K; i++)
+         fat_buffer[i] = BUS_READ(calc_bank_addr(slot) + (i<<1));
+      check_image_free(fat_buffer);
+
+      copy_directory_to_buffer(calc_bank_addr(slot));
+      get_buffer_directory();
+   }
+}
+
+void run_erase_cart(void)
+{
+   flash_erase_range(fxbmp_mem, 128 * FLASH_SECTOR_SIZE);
+}
+
+struct workload workloads[] = {
+   { "save_empty",        setup_empty,     run_save_slot0 },
+   { "save_full",         setup_full,      run_save_slot1 },
+   { "resave_small_change", setup_changed, run_save_slot1 },
+   { "restore",           NULL,            run_restore },
+   { "view_all_banks",    setup_all_banks, run_view_all },
+   { "erase_cart",        NULL,            run_erase_cart },
+};
+
+#define NUM_WORKLOADS  (sizeof(workloads) / sizeof(workloads[0]))
+
+
+void measure(struct workload * w, struct result * r)
+{
+u64 start;
+int op;
+
+   if (w->setup)
+      w->setup();
+
+   flashsim_clear_stats();
+   start = flashsim_time_ns();
+
+   w->run();
+
+   memset(r, 0, sizeof(*r));
+   strncpy(r->name, w->name, sizeof(r->name) - 1);
+
+   r->bytes_read       = flashsim_stats(FLASHSIM_OP_READ)->bus_reads;
+   r->bytes_programmed = flashsim_stats(FLASHSIM_OP_PROGRAM)->bytes;
+   r->sectors_erased   = flashsim_stats(FLASHSIM_OP_SECTOR_ERASE)->bytes +
+                         flashsim_stats(FLASHSIM_OP_CHIP_ERASE)->bytes;
+
+   for (op = 0; op < FLASHSIM_OP_COUNT; op++)
+      r->command_writes += flashsim_stats(op)->commands;
+
+   r->sim_ms = (flashsim_time_ns() - start) / 1000000.0;
+}
+
+int write_results(char * filename)
+{
+FILE * f;
+int i;
+
+   f = fopen(filename, "w");
+   if (f == NULL)
+      return(-1);
+
+   fprintf(f, "# workload bytes_read bytes_programmed sectors_erased command_writes sim_ms\n");
+   for (i = 0; i < num_results; i++)
+   {
+      fprintf(f, "%s %u %u %u %u %.3f\n", results[i].name,
+              results[i].bytes_read, results[i].bytes_programmed,
+              results[i].sectors_erased, results[i].command_writes, results[i].sim_ms);
+   }
+
+   fclose(f);
+   return(0);
+}
+
+int read_results(char * filename, struct result * list, int max)
+{
+FILE * f;
+char line[256];
+int count = 0;
+struct result * r;
+
+   f = fopen(filename, "r");
+   if (f == NULL)
+      return(-1);
+
+   while ((count < max) && fgets(line, sizeof(line), f))
+   {
+      if (line[0] == '#')
+         continue;
+
+      r = &list[count];
+      if (sscanf(line, "%31s %u %u %u %u %lf", r->name, &r->bytes_read, &r->bytes_programmed,
+                 &r->sectors_erased, &r->command_writes, &r->sim_ms) == 6)
+         count++;
+   }
+
+   fclose(f);
+   return(count);
+}
+
+// print each workload against the baseline; returns the number
+// of workloads which became slower by more than SLOWER_PERCENT
+//
+int compare_results(struct result * base, int num_base)
+{
+int i, j;
+int slower = 0;
+double change;
+
+   printf("\n%-20s %12s %12s %8s\n", "workload", "baseline ms", "now ms", "change");
+
+   for (i = 0; i < num_results; i++)
+   {
+      for (j = 0; j < num_base; j++)
+      {
+         if (strcmp(base[j].name, results[i].name) == 0)
+            break;
+      }
+
+      if (j == num_base)
+      {
+         printf("%-20s %12s %12.3f\n", results[i].name, "-", results[i].sim_ms);
+         continue;
+      }
+
+      change = (base[j].sim_ms > 0) ? (((results[i].sim_ms - base[j].sim_ms) * 100.0) / base[j].sim_ms) : 0;
+
+      // the baseline was written rounded, so an unchanged time can come
+      // out a hair below zero - which would be printed as "-0.0%"
+      if ((change > -0.05) && (change < 0.05))
+         change = 0;
+
+      printf("%-20s %12.3f %12.3f %+7.1f%%%s\n", results[i].name, base[j].sim_ms, results[i].sim_ms,
+             change, (change > SLOWER_PERCENT) ? "  SLOWER" : "");
+
+      if (change > SLOWER_PERCENT)
+         slower++;
+   }
+
+   return(slower);
+}
+
+void usage(void)
+{
+   printf("Usage:\n");
+   printf("   bench [-max] [-o <results>] [-compare <baseline results>]\n");
+   printf("\n");
+   printf("   -max uses the datasheet's maximum program and erase times, not typical\n");
+}
+
+int main(int argc, char *argv[])
+{
+struct result baseline[MAX_RESULTS];
+const struct flashsim_timing * timing = &flashsim_typical;
+char * outfile = "bench_results.txt";
+char * basefile = NULL;
+int num_base = 0;
+int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-max") == 0)
+         timing = &flashsim_maximum;
+      else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc))
+         outfile = argv[++i];
+      else if ((strcmp(argv[i], "-compare") == 0) && (i + 1 < argc))
+         basefile = argv[++i];
+      else
+      {
+         usage();
+         return(1);
+      }
+   }
+
+   if (basefile)
+   {
+      num_base = read_results(basefile, baseline, MAX_RESULTS);
+      if (num_base < 0)
+      {
+         printf("Error: cannot read %s\n", basefile);
+         return(1);
+      }
+   }
+
+   flashsim_reset(timing);
+   crc32_init();
+
+   printf("%-20s %10s %10s %8s %9s %12s\n", "workload", "read", "programmed", "erased", "commands", "sim ms");
+
+   for (i = 0; i < NUM_WORKLOADS; i++)
+   {
+      measure(&workloads[i], &results[num_results]);
+
+      printf("%-20s %10u %10u %8u %9u %12.3f\n", results[num_results].name,
+             results[num_results].bytes_read, results[num_results].bytes_programmed,
+             results[num_results].sectors_erased, results[num_results].command_writes,
+             results[num_results].sim_ms);
+      num_results++;
+   }
+
+   if (flashsim_violations() || flashsim_timeouts())
+      printf("flash model: %u programs tried to set bits, %u operations timed out\n",
+             flashsim_violations(), flashsim_timeouts());
+
+   if (write_results(outfile) != 0)
+   {
+      printf("Error: cannot write %s\n", outfile);
+      return(1);
+   }
+
+   if (basefile)
+      return(compare_results(baseline, num_base) ? 1 : 0);
+
+   return(0);
+}
@@ -0,0 +1,600 @@
+/*
+ *   bram.c - PC-FX backup memory images: the FAT filesystem in a 32KB
+ *            image, and moving images between memories and flash
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include <string.h>
+
+#include "bram.h"
+#include "telemetry.h"
+
+char dir_entry[64][20];
+u32  num_dir_entries;
+u16  dir_offset[64];
+u32  dir_size[64];
+u16  dir_clusters[64];
+
+u8   cluster_owner[FAT_FIRST_CLUSTER + FAT_ENTRIES_32K];
+
+u8   cluster_seen[(FAT_FIRST_CLUSTER + FAT_ENTRIES_32K + 7) / 8];
+int  fsck_cross_linked;
+int  fsck_out_of_range;
+int  fsck_orphaned;
+int  fsck_bad_entries;
+int  fsck_lost_files;
+
+void buffer_to_bram()
+{
+int i;
+
+   for (i = 0; i < 32768; i++)
+   {
+      bram_mem[(i<<1)] = bram_buffer[i];
+   }
+}
+
+// save bram_buffer into the slot at 'target'; the data and its CRC are
+// read back afterwards.  Returns the number of sectors and bytes which
+// timed out or did not read back (so 0 if the save is good)
+//
+int buffer_to_flash(u8 * target, char * date, char * comment)
+{
+int i;
+int failed;
+int bad = 0;
+u32 crc;
+u32 stored;
+
+   // erase storage slot (8 sectors data + 1 sector comments)
+   //
+   failed = flash_erase_range(target, FLASH_BANK_SIZE);
+
+   // write the core 32KB data into the storage slot
+   // 
+   failed += flash_program(target, bram_buffer, 32768);
+
+   // add storage of metadata (data / comment)
+   for (i = 0; i < 11; i++)
+   {
+//      *(target + (FLASH_BANK_CMNT * 2) + (i * 2)) = date[i];
+      flash_write( (target + (FLASH_BANK_CMNT * 2) + (i * 2)), date[i]);
+   }
+//   *(target + (FLASH_BANK_CMNT * 2) + (11 * 2)) = 0;
+   flash_write( (target + (FLASH_BANK_CMNT * 2) + (11 * 2)), 0);
+
+
+   for (i = 0; i < COMMENT_LENGTH; i++)
+   {
+//      *(target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (i * 2)) = comment[i];
+      flash_write( (target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (i * 2)), comment[i]);
+   }
+//   *(target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (16 * 2)) = 0;
+   flash_write( (target + ((FLASH_BANK_CMNT + COMMENT_OFFSET) * 2) + (COMMENT_LENGTH * 2)), 0);
+
+   // CRC of the data, so that a restore can tell it is intact
+   crc = crc32_buffer(bram_buffer, 32768);
+
+   flash_write( (target + ((FLASH_BANK_CMNT + CRC_OFFSET) * 2)), 'C');
+   flash_write( (target + ((FLASH_BANK_CMNT + CRC_OFFSET + 1) * 2)), 'K');
+   for (i = 0; i < 4; i++)
+   {
+      flash_write( (target + ((FLASH_BANK_CMNT + CRC_OFFSET + 2 + i) * 2)), (crc >> (i * 8)) & 0xFF);
+   }
+
+   // add the list of directory names, so that finding which slots
+   // hold a game only needs to read the metadata sector
+   get_buffer_directory();
+
+   flash_write( (target + ((FLASH_BANK_CMNT + INDEX_OFFSET) * 2)), 'I');
+   flash_write( (target + ((FLASH_BANK_CMNT + INDEX_OFFSET + 1) * 2)), 'X');
+   flash_write( (target + ((FLASH_BANK_CMNT + INDEX_OFFSET + 2) * 2)), num_dir_entries);
+
+   for (i = 0; i < (num_dir_entries * INDEX_NAME_SIZE); i++)
+   {
+      flash_write( (target + ((FLASH_BANK_CMNT + INDEX_NAMES) * 2) + (i * 2)),
+                   dir_entry[i / INDEX_NAME_SIZE][i % INDEX_NAME_SIZE]);
+   }
+
+   // read back the data, and the CRC which a restore will check it against
+   //
+   for (i = 0; i < 32768; i++)
+   {
+      if (BUS_READ(target + (i<<1)) != bram_buffer[i])
+         bad++;
+   }
+
+   stored = 0;
+   for (i = 0; i < 4; i++)
+      stored |= (u32) BUS_READ(target + ((FLASH_BANK_CMNT + CRC_OFFSET + 2 + i) * 2)) << (i * 8);
+
+   if ((BUS_READ(target + ((FLASH_BANK_CMNT + CRC_OFFSET) * 2)) != 'C') ||
+       (BUS_READ(target + ((FLASH_BANK_CMNT + CRC_OFFSET + 1) * 2)) != 'K') ||
+       (stored != crc))
+      bad++;
+
+   if (bad)
+      telemetry_verify_failure();
+
+   telemetry_flush();
+
+   return(failed + bad);
+}
+
+void copy_image_to(u8 * dest, u8 * source)
+{
+int i;
+
+   for (i = 0; i < 32768; i++)
+   {
+      dest[i] = BUS_READ(source + (i<<1));
+   }
+}
+
+void copy_to_buffer(u8 * source)
+{
+   copy_image_to(bram_buffer, source);
+}
+
+int check_image_free(u8 * img)
+{
+int i;
+int entrya, entryb;
+int available = 0;
+int start_addr, end_addr;
+
+   start_addr = FAT_OFFSET + FAT_RESERVED;
+   end_addr = start_addr + (FAT_ENTRIES_32K * 3 / 2);
+
+   for (i = start_addr; i < end_addr; i += 3)
+   {
+      entrya = ((img[i+1] & 0xf) << 8) + img[i];
+      entryb = (img[i+2] << 4) + ((img[i+1] & 0xf0) >> 4);
+
+      if (entrya == 0)
+         available += FAT_SECTOR_SIZE;
+
+      if (entryb == 0)
+         available += FAT_SECTOR_SIZE;
+   }
+
+   return(available);
+}
+
+int check_buffer_free()
+{
+   return(check_image_free(bram_buffer));
+}
+
+void get_buffer_directory(void)
+{
+int i;
+int j, k;
+int start_addr, end_addr;
+
+   num_dir_entries = 0;     // clear previous records
+   for (j = 0; j < 64; j++)
+   {
+      for (k = 0; k < 20; k++)
+      {
+         dir_entry[j][k] = 0;
+      }
+   }
+
+   start_addr = FAT_DIR_OFFSET_32K;
+   end_addr = start_addr + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE);
+
+   for (i = start_addr; i < end_addr; i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (bram_buffer[i] == 0)
+         break;
+
+      if (bram_buffer[i] == '.')
+         continue;
+
+      if (bram_buffer[i] == 0xE5)
+         continue;
+
+      for (j = 0; j < 8; j++)
+      {
+         dir_entry[num_dir_entries][j] = bram_buffer[i+j];
+      }
+      for (j = 12; j < 21; j++)
+      {
+         dir_entry[num_dir_entries][j-4] = bram_buffer[i+j];
+      }
+      dir_offset[num_dir_entries] = i;
+      num_dir_entries++;
+   }
+
+   return;
+}
+
+void copy_directory_to_buffer(u8 * source)
+{
+int i;
+
+   // only the directory area is needed to list names, so
+   // avoid reading the full 32KB of the slot
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i++)
+   {
+      bram_buffer[i] = BUS_READ(source + (i<<1));
+   }
+}
+
+// FAT12 entry 'cluster' of the FAT within 'img'
+//
+int fat_entry(u8 * img, int cluster)
+{
+int offset;
+
+   offset = FAT_OFFSET + ((cluster * 3) >> 1);
+
+   if (cluster & 1)
+      return( ((img[offset+1]) << 4) + ((img[offset] & 0xf0) >> 4) );
+   else
+      return( ((img[offset+1] & 0xf) << 8) + img[offset] );
+}
+
+int fat_valid_cluster(int cluster)
+{
+   return( (cluster >= FAT_FIRST_CLUSTER) && (cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K)) );
+}
+
+// hash every allocated cluster of 'img' (FNV-1a);
+// free clusters are skipped and left at zero
+//
+void fat_hash_clusters(u8 * img, u32 * hashes)
+{
+int cluster;
+int i;
+u8 * data;
+u32 hash;
+
+   for (cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      hashes[cluster] = 0;
+
+      if (fat_entry(img, cluster) == 0)
+         continue;
+
+      data = img + FAT_DATA_OFFSET_32K + ((cluster - FAT_FIRST_CLUSTER) * FAT_SECTOR_SIZE);
+      hash = 2166136261u;
+
+      for (i = 0; i < FAT_SECTOR_SIZE; i++)
+      {
+         hash = (hash ^ data[i]) * 16777619u;
+      }
+      hashes[cluster] = hash;
+   }
+}
+
+// directory entry name in the same form as dir_entry[]
+//
+void dir_entry_name(u8 * img, int offset, char * name)
+{
+int j;
+
+   memset(name, 0, 20);
+
+   for (j = 0; j < 8; j++)
+   {
+      name[j] = img[offset+j];
+   }
+   for (j = 12; j < 21; j++)
+   {
+      name[j-4] = img[offset+j];
+   }
+}
+
+int dir_entry_used(u8 * img, int offset)
+{
+   return( (img[offset] != 0) && (img[offset] != '.') && (img[offset] != 0xE5) );
+}
+
+// find the directory entry named 'name' within 'img';
+// returns its offset, or 0 if not present
+//
+int dir_find_entry(u8 * img, char * name)
+{
+int i;
+char entry_name[20];
+
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (img[i] == 0)
+         break;
+
+      if (!dir_entry_used(img, i))
+         continue;
+
+      dir_entry_name(img, i, entry_name);
+      if (memcmp(entry_name, name, INDEX_NAME_SIZE) == 0)
+         return(i);
+   }
+   return(0);
+}
+
+// build cluster_owner[] and each file's size and cluster count;
+// each FAT entry is visited at most once, so this stays linear
+// in the number of clusters however many files there are
+// (call after get_buffer_directory)
+//
+void get_buffer_usage(void)
+{
+int i;
+int cluster;
+int offset;
+
+   memset(cluster_owner, 0xFF, sizeof(cluster_owner));
+
+   for (i = 0; i < num_dir_entries; i++)
+   {
+      offset = dir_offset[i];
+
+      memcpy(&dir_size[i], &bram_buffer[offset + DIR_FILE_SIZE], 4);
+      dir_clusters[i] = 0;
+
+      cluster = bram_buffer[offset + DIR_START_CLUSTER] + (bram_buffer[offset + DIR_START_CLUSTER + 1] << 8);
+
+      while (fat_valid_cluster(cluster) && (cluster_owner[cluster] == 0xFF))
+      {
+         cluster_owner[cluster] = i;
+         dir_clusters[i]++;
+         cluster = fat_entry(bram_buffer, cluster);
+      }
+   }
+}
+
+void fat_set_entry(u8 * img, int cluster, int value)
+{
+int offset;
+
+   offset = FAT_OFFSET + ((cluster * 3) >> 1);
+
+   if (cluster & 1)
+   {
+      img[offset]   = (img[offset] & 0x0f) | ((value & 0xf) << 4);
+      img[offset+1] = (value >> 4) & 0xff;
+   }
+   else
+   {
+      img[offset]   = value & 0xff;
+      img[offset+1] = (img[offset+1] & 0xf0) | ((value >> 8) & 0xf);
+   }
+}
+
+// Check the FAT filesystem in bram_buffer for cross-linked, out-of-range
+// and orphaned cluster chains, and for directory entries which do not
+// match their chains.  Each cluster is visited once (tracked in
+// cluster_seen[]), so this completes well within a frame.
+//
+// If 'repair' is set, problems are fixed in the buffer:
+//   - chains are cut (end-of-chain) where they leave the valid range
+//     or run into a cluster already used
+//   - entries which start outside the valid range, or on a cluster
+//     already used by another file, are deleted (counted in
+//     fsck_lost_files, so that the user can be told beforehand)
+//   - file sizes are trimmed to fit the clusters actually allocated
+//   - orphaned clusters are freed
+//
+// Clusters marked bad (FAT_BAD_CLUSTER) are not errors, and are left
+// marked: a chain ending on one ends there, and one which no file uses
+// is not an orphan.
+//
+// Returns the number of problems found.
+//
+int fsck_buffer(int repair)
+{
+int i;
+int cluster, next, prev;
+int count;
+u32 size;
+
+   fsck_cross_linked = 0;
+   fsck_out_of_range = 0;
+   fsck_orphaned = 0;
+   fsck_bad_entries = 0;
+   fsck_lost_files = 0;
+
+   memset(cluster_seen, 0, sizeof(cluster_seen));
+
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (bram_buffer[i] == 0)
+         break;
+
+      if (!dir_entry_used(bram_buffer, i))
+         continue;
+
+      memcpy(&size, &bram_buffer[i + DIR_FILE_SIZE], 4);
+      cluster = bram_buffer[i + DIR_START_CLUSTER] + (bram_buffer[i + DIR_START_CLUSTER + 1] << 8);
+
+      if ((cluster == 0) && (size == 0))   // empty file
+         continue;
+
+      if (!fat_valid_cluster(cluster))
+      {
+         fsck_bad_entries++;
+         fsck_lost_files++;
+         if (repair)
+            bram_buffer[i] = 0xE5;
+         continue;
+      }
+
+      prev = -1;
+      count = 0;
+
+      while (1)
+      {
+         if (cluster_seen[cluster >> 3] & (1 << (cluster & 7)))
+         {
+            fsck_cross_linked++;
+            if (prev < 0)
+               fsck_lost_files++;
+            if (repair)
+            {
+               if (prev < 0)
+                  bram_buffer[i] = 0xE5;
+               else
+                  fat_set_entry(bram_buffer, prev, FAT_END_MARK);
+            }
+            break;
+         }
+
+         cluster_seen[cluster >> 3] |= (1 << (cluster & 7));
+         count++;
+
+         next = fat_entry(bram_buffer, cluster);
+
+         if ((next >= FAT_END_OF_CHAIN) || (next == FAT_BAD_CLUSTER))
+            break;
+
+         if (!fat_valid_cluster(next))
+         {
+            fsck_out_of_range++;
+            if (repair)
+               fat_set_entry(bram_buffer, cluster, FAT_END_MARK);
+            break;
+         }
+
+         prev = cluster;
+         cluster = next;
+      }
+
+      if ((bram_buffer[i] != 0xE5) && (size > (count * FAT_SECTOR_SIZE)))
+      {
+         fsck_bad_entries++;
+         if (repair)
+         {
+            size = count * FAT_SECTOR_SIZE;
+            memcpy(&bram_buffer[i + DIR_FILE_SIZE], &size, 4);
+         }
+      }
+   }
+
+   for (cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      if ((cluster_seen[cluster >> 3] & (1 << (cluster & 7))) == 0)
+      {
+         next = fat_entry(bram_buffer, cluster);
+
+         if ((next != 0) && (next != FAT_BAD_CLUSTER))
+         {
+            fsck_orphaned++;
+            if (repair)
+               fat_set_entry(bram_buffer, cluster, 0);
+         }
+      }
+   }
+
+   return(fsck_cross_linked + fsck_out_of_range + fsck_orphaned + fsck_bad_entries);
+}
+
+// Rewrite the image in bram_buffer so that each file occupies consecutive
+// clusters (in directory order), with all free space at the end and
+// deleted directory entries squeezed out.  diff_buffer is used as the
+// scratch image.  The buffer must pass fsck_buffer() first, as a
+// cross-linked cluster would otherwise be copied twice.
+// Clusters marked bad stay marked where they are, and are stepped over.
+//
+static int defrag_next_cluster(int cluster)
+{
+   while (fat_valid_cluster(cluster) && (fat_entry(diff_buffer, cluster) == FAT_BAD_CLUSTER))
+      cluster++;
+
+   return(cluster);
+}
+
+void defrag_buffer(void)
+{
+int i;
+int dest;
+int cluster, next;
+int new_cluster, following;
+int steps;
+
+   memcpy(diff_buffer, bram_buffer, FAT_OFFSET + FAT_RESERVED);
+   memset(diff_buffer + FAT_OFFSET + FAT_RESERVED, 0, 32768 - (FAT_OFFSET + FAT_RESERVED));
+
+   for (cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      if (fat_entry(bram_buffer, cluster) == FAT_BAD_CLUSTER)
+         fat_set_entry(diff_buffer, cluster, FAT_BAD_CLUSTER);
+   }
+
+   new_cluster = defrag_next_cluster(FAT_FIRST_CLUSTER);
+   dest = FAT_DIR_OFFSET_32K;
+
+   for (i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (bram_buffer[i] == 0)
+         break;
+
+      if (bram_buffer[i] == 0xE5)
+         continue;
+
+      memcpy(diff_buffer + dest, bram_buffer + i, FAT_DIR_ENTRY_SIZE);
+
+      cluster = bram_buffer[i + DIR_START_CLUSTER] + (bram_buffer[i + DIR_START_CLUSTER + 1] << 8);
+
+      if (fat_valid_cluster(cluster) && fat_valid_cluster(new_cluster))
+      {
+         diff_buffer[dest + DIR_START_CLUSTER]     = new_cluster & 0xff;
+         diff_buffer[dest + DIR_START_CLUSTER + 1] = new_cluster >> 8;
+
+         for (steps = 0; fat_valid_cluster(cluster) && fat_valid_cluster(new_cluster) && (steps < FAT_ENTRIES_32K); steps++)
+         {
+            memcpy(diff_buffer + FAT_DATA_OFFSET_32K + ((new_cluster - FAT_FIRST_CLUSTER) * FAT_SECTOR_SIZE),
+                   bram_buffer + FAT_DATA_OFFSET_32K + ((cluster - FAT_FIRST_CLUSTER) * FAT_SECTOR_SIZE),
+                   FAT_SECTOR_SIZE);
+
+            next = fat_entry(bram_buffer, cluster);
+            following = defrag_next_cluster(new_cluster + 1);
+
+            fat_set_entry(diff_buffer, new_cluster,
+                          (fat_valid_cluster(next) && fat_valid_cluster(following)) ? following : FAT_END_MARK);
+
+            new_cluster = following;
+            cluster = next;
+         }
+      }
+
+      dest += FAT_DIR_ENTRY_SIZE;
+   }
+
+   memcpy(bram_buffer, diff_buffer, 32768);
+}
+
+int is_bram_formatted()
+{
+static int retval;
+
+   if ((bram_mem[6] == 'P') && (bram_mem[8] == 'C') &&
+       (bram_mem[10] == 'F') && (bram_mem[12] == 'X') &&
+       (bram_mem[14] == 'S') && (bram_mem[16] == 'r') &&
+       (bram_mem[18] == 'a') && (bram_mem[20] == 'm'))
+
+      retval = 1;
+   else
+      retval = 0;
+
+   return(retval);
+}
+
+u8 is_formatted(u8 * buf)
+{
+static int retval;
+
+   if ((BUS_READ(buf + 6) == 'P') && (BUS_READ(buf + 8) == 'C') &&
+       (BUS_READ(buf + 10) == 'F') && (BUS_READ(buf + 12) == 'X') &&
+       (BUS_READ(buf + 14) == 'S') && (BUS_READ(buf + 16) == 'r') &&
+       (BUS_READ(buf + 18) == 'a') && (BUS_READ(buf + 20) == 'm'))
+
+      retval = 1;
+   else
+      retval = 0;
+
+   return(retval);
+}
@@ -0,0 +1,71 @@
+/*
+ *   bram.h - PC-FX backup memory images: the FAT filesystem in a 32KB
+ *            image, and moving images between memories and flash
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#ifndef BRAM_H
+#define BRAM_H
+
+#include "hal.h"
+#include "flash.h"
+
+// These FAT attributes are for the 32KB internal SRAM
+// on the PC-FX; different values would be used when
+// reporting on larger external memory carts
+//
+#define FAT_OFFSET           0x80
+#define FAT_RESERVED         3
+#define FAT_ENTRIES_32K      236
+#define FAT_SECTOR_SIZE      128
+#define FAT_DIR_OFFSET_32K   0x200
+#define FAT_DIR_ENTRIES_32K  64
+#define FAT_DIR_ENTRY_SIZE   32
+#define FAT_DATA_OFFSET_32K  0xA00   // location of first data cluster (cluster #2)
+#define FAT_FIRST_CLUSTER    2
+#define FAT_BAD_CLUSTER      0xFF7   // cluster marked unusable; never allocated or freed
+#define FAT_END_OF_CHAIN     0xFF8   // entries at or above this end a chain
+#define FAT_END_MARK         0xFFF   // value written to end a chain
+
+#define DIR_START_CLUSTER    26      // offsets of fields within a directory entry
+#define DIR_FILE_SIZE        28
+
+extern char dir_entry[64][20]; // up to 64 entries of 19 characters (plus null terminator) each (in FAT)
+extern u32  num_dir_entries;
+extern u16  dir_offset[64];    // location of each entry's directory record within bram_buffer
+extern u32  dir_size[64];      // file size, from the directory record
+extern u16  dir_clusters[64];  // clusters actually allocated to the file, from the FAT
+
+extern u8   cluster_owner[FAT_FIRST_CLUSTER + FAT_ENTRIES_32K];  // dir_entry[] index owning each cluster
+
+// results of the last consistency check of bram_buffer
+extern u8   cluster_seen[(FAT_FIRST_CLUSTER + FAT_ENTRIES_32K + 7) / 8];
+extern int  fsck_cross_linked;
+extern int  fsck_out_of_range;
+extern int  fsck_orphaned;
+extern int  fsck_bad_entries;
+extern int  fsck_lost_files;   // entries which a repair deletes (no clusters of their own)
+
+void buffer_to_bram(void);
+int  buffer_to_flash(u8 * target, char * date, char * comment);
+void copy_image_to(u8 * dest, u8 * source);
+void copy_to_buffer(u8 * source);
+int  check_image_free(u8 * img);
+int  check_buffer_free(void);
+void get_buffer_directory(void);
+void copy_directory_to_buffer(u8 * source);
+int  fat_entry(u8 * img, int cluster);
+int  fat_valid_cluster(int cluster);
+void fat_hash_clusters(u8 * img, u32 * hashes);
+void dir_entry_name(u8 * img, int offset, char * name);
+int  dir_entry_used(u8 * img, int offset);
+int  dir_find_entry(u8 * img, char * name);
+void get_buffer_usage(void);
+void fat_set_entry(u8 * img, int cluster, int value);
+int  fsck_buffer(int repair);
+void defrag_buffer(void);
+int  is_bram_formatted(void);
+u8   is_formatted(u8 * buf);
+
+#endif
@@ -0,0 +1,489 @@
+/*
+ *   console.c - display, joypad, timer and interrupts of the PC-FX,
+ *               for both programs
+ *
+ *   Text is printed on the first 7up's background (64x32 cells), using
+ *   the font which each program supplies (font.s).  print_at() and
+ *   friends only update a RAM copy of the BAT; vsync() sends the cells
+ *   which changed to VRAM at the start of vblank.
+ *
+ *   The joypad is read in the VSYNC interrupt, and each frame's new
+ *   presses (plus auto-repeats of held directions) are queued as one
+ *   event; vsync() takes one event per frame into joytrg, so presses
+ *   are neither lost nor seen twice however long a frame takes.
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include <stdio.h>
+
+#include <eris/types.h>
+#include <eris/std.h>
+#include <eris/v810.h>
+#include <eris/king.h>
+#include <eris/low/7up.h>
+#include <eris/tetsu.h>
+#include <eris/bkupmem.h>
+#include <eris/timer.h>
+#include <eris/pad.h>
+
+#include "hal.h"
+#include "flash.h"
+
+/* HuC6270-A's status register (RAM mapping). Used during VSYNC interrupt */
+volatile uint16_t * const MEM_6270A_SR = (uint16_t *) 0x80000400;
+
+/* HuC6270-A's register select and data ports, and KING's (RAM mapping). */
+/* Used for block transfers, which select the data register only once.  */
+/* (Reading MEM_6270A_SR does not change the selected register.)         */
+volatile uint16_t * const MEM_6270A_AR   = (uint16_t *) 0x80000400;
+volatile uint16_t * const MEM_6270A_DATA = (uint16_t *) 0x80000404;
+volatile uint16_t * const MEM_KING_AR    = (uint16_t *) 0x80000600;
+volatile uint16_t * const MEM_KING_DATA  = (uint16_t *) 0x80000604;
+
+#define SUP_REG_VWR         2          // HuC6270 VRAM write data register
+#define SUP_REG_CR          5          // HuC6270 control register
+#define SUP_CR_BG           0x88       // BG shown; VSYNC interrupt
+#define SUP_CR_BG_SPRITES   0xC8       // BG and sprites shown; VSYNC interrupt
+#define SUP_STATUS_VD       0x20       // status: VSYNC
+#define KING_REG_KRAM_DATA  0x0E       // KING KRAM read/write data register
+#define KRAM_LINE           32         // KRAM words per line of KING BG0 (256 pixels, 4 colors)
+
+#define FONT_ADDR           0x1200     // characters 0x20-0x7F, after the BAT
+#define FONT_WORDS          (0x60 * 16)
+
+/* Timer - free-running, counting down from TIMER_PERIOD at CPU clock / 15 */
+#define TIMER_PERIOD        0xFFFF
+
+#define EVENT_QUEUE_SIZE    16         // power of 2
+#define REPEAT_KEYS         (JOY_UP | JOY_DOWN | JOY_LEFT | JOY_RIGHT)
+
+// interrupt-handling variables
+volatile int sda_frame_count = 0;
+volatile int last_sda_frame_count = 0;
+
+volatile u32 timer_wraps = 0;
+u32 boot_ticks = 0;                    // from start of console_init() to the first menu frame
+
+void (*vsync_hook)(void) = NULL;
+void (*frame_end_hook)(u32 caller, int late) = NULL;
+
+#ifdef PROFILE
+u32  print_busy_ticks;
+#endif
+
+/* RAM copy of the 7up BAT, and the changed span of each row */
+u16  bat_shadow[BAT_HEIGHT][BAT_WIDTH];
+u8   bat_dirty_lo[BAT_HEIGHT];   // first changed column (BAT_WIDTH = row is clean)
+u8   bat_dirty_hi[BAT_HEIGHT];   // last changed column
+
+
+///////////////////////////////// Joypad routines
+volatile u32 joypad;
+volatile u32 joypad_last;
+u32 joytrg;                                  // event for this frame (from vsync())
+
+volatile u32 event_queue[EVENT_QUEUE_SIZE];
+volatile int event_head = 0;                 // next free entry - written by joyread()
+volatile int event_tail = 0;                 // next event - written by input_next()
+
+int repeat_delay = REPEAT_DELAY;
+int repeat_rate  = REPEAT_RATE;
+int repeat_count = 0;
+
+__attribute__ ((noinline)) void joyread(void)
+{
+u32 temp;
+u32 event;
+int next;
+
+   joypad_last = joypad;
+   temp = eris_pad_read(0);
+
+   if ((temp >> 28) == PAD_TYPE_FXPAD)    // PAD TYPE
+      joypad = temp;
+   else
+      joypad = 0;
+
+   event = (~joypad_last) & joypad;
+
+   // repeat directions for as long as the same ones stay held
+   if (((joypad & REPEAT_KEYS) != 0) &&
+       ((joypad & REPEAT_KEYS) == (joypad_last & REPEAT_KEYS)))
+   {
+      if (++repeat_count >= repeat_delay)
+      {
+         // only once the menu has caught up, so that repeats cannot
+         // pile up behind a slow frame and outlast the key
+         if (event_head == event_tail)
+            event |= (joypad & REPEAT_KEYS);
+         repeat_count -= repeat_rate;
+      }
+   }
+   else
+   {
+      repeat_count = 0;
+   }
+
+   if (event != 0)
+   {
+      next = (event_head + 1) & (EVENT_QUEUE_SIZE - 1);
+
+      if (next != event_tail)     /* if full, the newest event is dropped */
+      {
+         event_queue[event_head] = event;
+         event_head = next;
+      }
+   }
+}
+
+// take the oldest queued event (0 if none)
+//
+u32 input_next(void)
+{
+u32 event;
+
+   if (event_tail == event_head)
+      return(0);
+
+   event = event_queue[event_tail];
+   event_tail = (event_tail + 1) & (EVENT_QUEUE_SIZE - 1);
+
+   return(event);
+}
+
+// discard queued events - so that keys pressed during a long
+// operation cannot answer the next question
+//
+void input_flush(void)
+{
+   event_tail = event_head;
+   joytrg = 0;
+}
+
+///////////////////////////////// Interrupt handlers
+__attribute__ ((interrupt_handler)) void my_timer_irq (void)
+{
+   eris_timer_ack_irq();
+   timer_wraps++;
+}
+
+__attribute__ ((interrupt_handler)) void my_vblank_irq (void)
+{
+   uint16_t vdc_status = *MEM_6270A_SR;
+
+   if (vdc_status & SUP_STATUS_VD) {
+      sda_frame_count++;
+      joyread();
+   }
+}
+
+// timer ticks since console_init() started the timer
+//
+u32 ticks_now(void)
+{
+u32 wraps;
+u16 count;
+
+   do {
+      wraps = timer_wraps;
+      count = eris_timer_read_counter();
+   } while (wraps != timer_wraps);
+
+   return((wraps * TIMER_PERIOD) + (TIMER_PERIOD - count));
+}
+
+void vsync(int numframes)
+{
+   // the frame was late if the vblank it should have waited for has gone
+   if (frame_end_hook)
+      frame_end_hook((u32) __builtin_return_address(0),
+                     sda_frame_count >= (last_sda_frame_count + numframes + 1));
+
+   while (sda_frame_count < (last_sda_frame_count + numframes + 1));
+
+   last_sda_frame_count = sda_frame_count;
+
+   bat_flush();
+
+   if (vsync_hook)
+      vsync_hook();
+
+   joytrg = input_next();
+}
+
+
+///////////////////////////////// Video memory
+
+// write 'count' words from 'src' to 7up VRAM at 'addr'
+//
+void sup_vram_block(u16 addr, u16 * src, int count)
+{
+   eris_low_sup_set_vram_write(0, addr);
+   *MEM_6270A_AR = SUP_REG_VWR;
+
+   while (count-- > 0) {
+      *MEM_6270A_DATA = *src++;
+   }
+}
+
+void sup_vram_fill(u16 addr, u16 value, int count)
+{
+   eris_low_sup_set_vram_write(0, addr);
+   *MEM_6270A_AR = SUP_REG_VWR;
+
+   while (count-- > 0) {
+      *MEM_6270A_DATA = value;
+   }
+}
+
+void king_kram_fill(u32 addr, u16 value, int count)
+{
+   eris_king_set_kram_write(addr, 1);
+   *MEM_KING_AR = KING_REG_KRAM_DATA;
+
+   while (count-- > 0) {
+      *MEM_KING_DATA = value;
+   }
+}
+
+
+///////////////////////////////// Text
+
+// print with first 7up (HuC6270 #0)
+//
+// These only update bat_shadow[]; cells which actually change are
+// sent to VRAM by bat_flush() during the next vsync()
+//
+void print_at(int x, int y, int pal, char* str)
+{
+u16 *cell;
+u16 a;
+u16 base;
+int lo;
+#ifdef PROFILE
+u32 start = ticks_now();
+#endif
+
+   cell = &bat_shadow[y][x];
+   base = (pal * 0x1000) + 0x100;
+   lo = BAT_WIDTH;
+
+   while ((*str != 0) && (x < BAT_WIDTH)) {
+      a = base + (u8) *str;
+      if (*cell != a) {
+         *cell = a;
+         if (lo == BAT_WIDTH)
+            lo = x;
+         if (x > bat_dirty_hi[y])
+            bat_dirty_hi[y] = x;
+      }
+      cell++;
+      str++;
+      x++;
+   }
+
+   if (lo < bat_dirty_lo[y])
+      bat_dirty_lo[y] = lo;
+
+#ifdef PROFILE
+   print_busy_ticks += ticks_now() - start;
+#endif
+}
+
+void putch_at(int x, int y, int pal, char c)
+{
+u16 a;
+
+   a = (pal * 0x1000) + (u8) c + 0x100;
+
+   if (bat_shadow[y][x] != a) {
+      bat_shadow[y][x] = a;
+      if (x < bat_dirty_lo[y])
+         bat_dirty_lo[y] = x;
+      if (x > bat_dirty_hi[y])
+         bat_dirty_hi[y] = x;
+   }
+}
+
+void putnumber_at(int x, int y, int pal, int len, int value)
+{
+char str[64];
+
+   str[0] = '\0';
+
+   if (len == 2) {
+      sprintf(str, "%2d", value);
+   }
+   else if (len == 4) {
+      sprintf(str, "%4d", value);
+   }
+   else if (len == 5) {
+      sprintf(str, "%5d", value);
+   }
+
+   print_at(x, y, pal, str);
+}
+
+// copy the changed span of each BAT row from bat_shadow[] to VRAM
+// (called from vsync(), so this happens at the start of vblank)
+//
+void bat_flush(void)
+{
+int y;
+int x;
+
+   for (y = 0; y < BAT_HEIGHT; y++) {
+      if (bat_dirty_lo[y] > bat_dirty_hi[y])
+         continue;
+
+      x = bat_dirty_lo[y];
+
+      sup_vram_block((y * BAT_WIDTH) + x, &bat_shadow[y][x], bat_dirty_hi[y] - x + 1);
+
+      bat_dirty_lo[y] = BAT_WIDTH;
+      bat_dirty_hi[y] = 0;
+   }
+}
+
+
+///////////////////////////////// Setup
+
+// set up the video chips, the text screen and palettes, the joypad,
+// and the timer and VSYNC interrupts; KING BG0 (256 wide) is given
+// 'bg0_lines' lines (256 or 512), which are cleared, and the 7up's
+// sprites are shown if 'sprites' is set
+//
+void console_init(int bg0_lines, int sprites)
+{
+int i, j;
+u16 microprog[16];
+
+   // start the timer first, so that startup time can be measured
+   eris_timer_init();
+   eris_timer_set_period(TIMER_PERIOD);
+   eris_timer_start(1);
+   flash_clock = ticks_now;       // flash operations are timed for the telemetry record
+
+   eris_low_sup_init(0);
+   eris_low_sup_init(1);
+   eris_king_init();
+   eris_tetsu_init();
+
+   eris_tetsu_set_priorities(0, 0, 1, 0, 0, 0, 0);
+   eris_tetsu_set_7up_palette(0, 0);
+   eris_tetsu_set_king_palette(0, 0, 0, 0);
+   eris_tetsu_set_rainbow_palette(0);
+
+   eris_king_set_bg_prio(KING_BGPRIO_3, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, 0);
+   eris_king_set_bg_mode(KING_BGMODE_4_PAL, 0, 0, 0);
+   eris_king_set_kram_pages(0, 0, 0, 0);
+
+   for (i = 0; i < 16; i++) {
+      microprog[i] = KING_CODE_NOP;
+   }
+
+   microprog[0] = KING_CODE_BG0_CG_0;
+   eris_king_disable_microprogram();
+   eris_king_write_microprogram(microprog, 0, 16);
+   eris_king_enable_microprogram();
+
+   /* Font uses sub-palette #1 for FG, #2 for BG */
+   /* palette #0 is default - light green background, bright white foreground */
+   eris_tetsu_set_palette(0x00, 0x2A66);
+   eris_tetsu_set_palette(0x01, 0xFC88);
+   eris_tetsu_set_palette(0x02, 0x2A66);
+
+   /* palette #1 is selection/inverse - bright white background, light green foreground */
+   eris_tetsu_set_palette(0x10, 0xFC88);
+   eris_tetsu_set_palette(0x11, 0x2A66);
+   eris_tetsu_set_palette(0x12, 0xFC88);
+
+   /* palette #2 is disabled/dimmed - light green background, dimmed white foreground */
+   eris_tetsu_set_palette(0x20, 0x2A66);
+   eris_tetsu_set_palette(0x21, 0x9088);
+   eris_tetsu_set_palette(0x22, 0x2A66);
+
+   /* palette #3 is error/red - light green background, bright red foreground */
+   eris_tetsu_set_palette(0x30, 0x2A66);
+   eris_tetsu_set_palette(0x31, 0x8B3B);  // TODO: get right RED (was 4B5F)
+   eris_tetsu_set_palette(0x32, 0x2A66);
+
+   /* palette #4 is highlight/yellow - light green background, bright yellow foreground */
+   eris_tetsu_set_palette(0x40, 0x2A66);
+   eris_tetsu_set_palette(0x41, 0xDF09);
+   eris_tetsu_set_palette(0x42, 0x2A66);
+
+   /* palette #5 is highlight/blue-green - light green background, blue-green foreground */
+   eris_tetsu_set_palette(0x50, 0x2A66);
+   eris_tetsu_set_palette(0x51, 0x9BB1);
+   eris_tetsu_set_palette(0x52, 0x2A66);
+
+   eris_tetsu_set_video_mode(TETSU_LINES_262, 0, TETSU_DOTCLOCK_7MHz, TETSU_COLORS_16,
+                             TETSU_COLORS_16, 1, 0, 1, 0, 0, 0, 0);
+   eris_king_set_bat_cg_addr(KING_BG0, 0, 0);
+   eris_king_set_bat_cg_addr(KING_BG0SUB, 0, 0);
+   eris_king_set_scroll(KING_BG0, 0, 0);
+   eris_king_set_bg_size(KING_BG0, (bg0_lines > 256) ? KING_BGSIZE_512 : KING_BGSIZE_256, KING_BGSIZE_256,
+                         KING_BGSIZE_256, KING_BGSIZE_256);
+   eris_low_sup_set_control(0, 0, 1, 0);
+   eris_low_sup_set_access_width(0, 0, SUP_LOW_MAP_64X32, 0, 0);
+   eris_low_sup_set_scroll(0, 0, 0);
+   //eris_low_sup_set_video_mode(0, 2, 2, 4, 0x1F, 0x11, 2, 239, 2); // 5MHz numbers
+   eris_low_sup_set_video_mode(0, 3, 3, 6, 0x2B, 0x11, 2, 239, 2);
+
+   eris_king_set_kram_read(0, 1);
+   // Clear BG0's RAM
+   king_kram_fill(0, 0, KRAM_LINE * bg0_lines);
+   eris_king_set_kram_write(0, 1);
+
+   sup_vram_fill(0, BAT_BLANK, BAT_WIDTH * BAT_HEIGHT);
+
+   for (i = 0; i < BAT_HEIGHT; i++) {
+      for (j = 0; j < BAT_WIDTH; j++) {
+         bat_shadow[i][j] = BAT_BLANK;
+      }
+      bat_dirty_lo[i] = BAT_WIDTH;
+      bat_dirty_hi[i] = 0;
+   }
+
+   // load font into video memory (already in tile format - see font.s)
+   sup_vram_block(FONT_ADDR, font, FONT_WORDS);
+
+   eris_pad_init(0); // initialize joypad
+
+   // Disable all interrupts before changing handlers.
+   irq_set_mask(0x7F);
+
+   // Replace firmware IRQ handlers for the Timer and HuC6270-A.
+   //
+   // This liberis function uses the V810's hardware IRQ numbering,
+   // see FXGA_GA and FXGABOAD documents for more info ...
+   irq_set_raw_handler(0x9, my_timer_irq);
+   irq_set_raw_handler(0xC, my_vblank_irq);
+
+   // Enable Timer and HuC6270-A interrupts.
+   //
+   // d6=Timer
+   // d5=External
+   // d4=KeyPad
+   // d3=HuC6270-A
+   // d2=HuC6272
+   // d1=HuC6270-B
+   // d0=HuC6273
+   irq_set_mask(0x37);
+
+   // Allow all IRQs.
+   //
+   // This liberis function uses the V810's hardware IRQ numbering,
+   // see FXGA_GA and FXGABOAD documents for more info ...
+   irq_set_level(8);
+
+   // Enable V810 CPU's interrupt handling.
+   irq_enable();
+
+   // Set Hu6270 BG (and sprites) to show, with VSYNC Interrupt
+   eris_low_sup_setreg(0, SUP_REG_CR, sprites ? SUP_CR_BG_SPRITES : SUP_CR_BG);
+
+   eris_bkupmem_set_access(1,1);  // allow read and write access to both internal and external backup memory
+}
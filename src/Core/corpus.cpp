@@ -0,0 +1,511 @@
+// (c) 2023 David Shadoff
+//
+// corpus.cpp - measurements over a directory of real 32KB BRAM dumps
+//
+// For each image, and for the corpus as a whole:
+//   - throughput of the core's free-space and directory parsers
+//     (check_image_free() and get_buffer_directory())
+//   - size and decode speed of candidate encodings for a slot
+//   - how much of the data is duplicated across images, at the level
+//     of clusters and of whole files
+//
+// Images are processed in parallel.  get_buffer_directory() fills the
+// core's global tables, so it is timed separately on one thread.
+// Times are of the host, and only comparable with each other.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <dirent.h>
+
+extern "C" {
+#include "bram.h"
+}
+#include "../Host_Tools/lzss.h"
+
+#define IMAGE_SIZE       32768
+#define PARSE_REPEATS    2000            // parser runs per image, for a measurable time
+#define DECODE_REPEATS   50
+#define HEADER_SIZE      FAT_DATA_OFFSET_32K   // boot sector, FAT and directory
+
+typedef std::chrono::steady_clock clock_type;
+
+enum encoding
+{
+   ENC_RAW = 0,     // as stored today
+   ENC_RLE,         // runs of a repeated byte
+   ENC_USED,        // header, then only the clusters allocated in the FAT
+   ENC_LZSS,        // unlzss.s stream
+   ENC_USED_LZSS,   // allocated clusters, then LZSS
+   ENC_COUNT
+};
+
+static const char * const enc_name[ENC_COUNT] = { "raw", "rle", "used", "lzss", "used+lzss" };
+
+struct image_result
+{
+   std::string name;
+   bool     valid;
+   int      files;
+   int      free_bytes;
+   double   free_mb_s;                  // check_image_free()
+   double   dir_mb_s;                   // get_buffer_directory()
+   size_t   enc_size[ENC_COUNT];
+   double   decode_mb_s[ENC_COUNT];
+   std::vector<uint32_t> cluster_hashes;   // allocated clusters only
+   std::vector<uint32_t> file_hashes;      // name and contents of each file
+};
+
+
+static double seconds_since(clock_type::time_point start)
+{
+   return(std::chrono::duration<double>(clock_type::now() - start).count());
+}
+
+static uint32_t fnv1a(const uint8_t * data, size_t len, uint32_t hash = 2166136261u)
+{
+   for (size_t i = 0; i < len; i++)
+      hash = (hash ^ data[i]) * 16777619u;
+   return(hash);
+}
+
+
+// runs of 3 or more of a byte as 0x00, count, byte (0x00 alone escapes itself)
+//
+static bytes rle_encode(const bytes & in)
+{
+bytes out;
+size_t i = 0;
+
+   while (i < in.size())
+   {
+      size_t run = 1;
+      while ((i + run < in.size()) && (in[i + run] == in[i]) && (run < 255))
+         run++;
+
+      if ((run >= 3) || (in[i] == 0))
+      {
+         out.push_back(0);
+         out.push_back(run);
+         out.push_back(in[i]);
+      }
+      else
+      {
+         for (size_t j = 0; j < run; j++)
+            out.push_back(in[i]);
+      }
+      i += run;
+   }
+   return(out);
+}
+
+static void rle_decode(const bytes & in, uint8_t * out)
+{
+size_t o = 0;
+
+   for (size_t i = 0; i < in.size(); )
+   {
+      if (in[i] == 0)
+      {
+         memset(out + o, in[i + 2], in[i + 1]);
+         o += in[i + 1];
+         i += 3;
+      }
+      else
+         out[o++] = in[i++];
+   }
+}
+
+// the header as it is, then each allocated cluster in order;
+// free clusters come back as zero
+//
+static bytes used_encode(const uint8_t * img)
+{
+bytes out(img, img + HEADER_SIZE);
+
+   for (int cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      if (fat_entry((u8 *) img, cluster) != 0)
+      {
+         const uint8_t * data = img + FAT_DATA_OFFSET_32K + ((cluster - FAT_FIRST_CLUSTER) * FAT_SECTOR_SIZE);
+         out.insert(out.end(), data, data + FAT_SECTOR_SIZE);
+      }
+   }
+   return(out);
+}
+
+static void used_decode(const uint8_t * in, uint8_t * out)
+{
+const uint8_t * data = in + HEADER_SIZE;
+
+   memcpy(out, in, HEADER_SIZE);
+   memset(out + HEADER_SIZE, 0, IMAGE_SIZE - HEADER_SIZE);
+
+   for (int cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      if (fat_entry(out, cluster) != 0)
+      {
+         memcpy(out + FAT_DATA_OFFSET_32K + ((cluster - FAT_FIRST_CLUSTER) * FAT_SECTOR_SIZE), data, FAT_SECTOR_SIZE);
+         data += FAT_SECTOR_SIZE;
+      }
+   }
+}
+
+
+// everything about one image which can be done on any thread
+//
+static void measure_image(const bytes & img, image_result & r)
+{
+uint8_t out[IMAGE_SIZE];
+uint8_t scratch[IMAGE_SIZE];
+bytes enc[ENC_COUNT];
+volatile int sink = 0;
+
+   r.valid = (memcmp(&img[3], "PCFXSram", 8) == 0);
+
+   if (!r.valid)
+      return;
+
+   // free-space parser
+   clock_type::time_point start = clock_type::now();
+   for (int i = 0; i < PARSE_REPEATS; i++)
+      sink += check_image_free((u8 *) img.data());
+   r.free_mb_s = (PARSE_REPEATS * (double)(FAT_ENTRIES_32K * 3 / 2)) / (seconds_since(start) * 1e6);
+   r.free_bytes = check_image_free((u8 *) img.data());
+
+   // encodings
+   bytes used = used_encode(img.data());
+
+   enc[ENC_RAW]       = img;
+   enc[ENC_RLE]       = rle_encode(img);
+   enc[ENC_USED]      = used;
+   enc[ENC_LZSS]      = lzss_compress(img);
+   enc[ENC_USED_LZSS] = lzss_compress(used);
+
+   for (int e = 0; e < ENC_COUNT; e++)
+   {
+      r.enc_size[e] = enc[e].size();
+
+      start = clock_type::now();
+      for (int i = 0; i < DECODE_REPEATS; i++)
+      {
+         switch (e)
+         {
+            case ENC_RAW:
+               memcpy(out, enc[e].data(), IMAGE_SIZE);
+               break;
+            case ENC_RLE:
+               rle_decode(enc[e], out);
+               break;
+            case ENC_USED:
+               used_decode(enc[e].data(), out);
+               break;
+            case ENC_LZSS:
+               lzss_decompress(enc[e].data(), enc[e].size(), out, IMAGE_SIZE);
+               break;
+            case ENC_USED_LZSS:
+               lzss_decompress(enc[e].data(), enc[e].size(), scratch, used.size());
+               used_decode(scratch, out);
+               break;
+         }
+         sink += out[i & (IMAGE_SIZE - 1)];
+      }
+      r.decode_mb_s[e] = (DECODE_REPEATS * (double) IMAGE_SIZE) / (seconds_since(start) * 1e6);
+
+      // the "used" encodings only keep allocated clusters, so compare those
+      if (e >= ENC_USED)
+      {
+         bytes expect = img;
+         used_decode(used.data(), expect.data());
+         if (memcmp(out, expect.data(), IMAGE_SIZE) != 0)
+            fprintf(stderr, "%s: %s encoding does not decode\n", r.name.c_str(), enc_name[e]);
+      }
+      else if (memcmp(out, img.data(), IMAGE_SIZE) != 0)
+         fprintf(stderr, "%s: %s encoding does not decode\n", r.name.c_str(), enc_name[e]);
+   }
+
+   // duplicate data: allocated clusters, and whole files
+   std::vector<uint32_t> hashes(FAT_FIRST_CLUSTER + FAT_ENTRIES_32K);
+   fat_hash_clusters((u8 *) img.data(), hashes.data());
+
+   for (int cluster = FAT_FIRST_CLUSTER; cluster < (FAT_FIRST_CLUSTER + FAT_ENTRIES_32K); cluster++)
+   {
+      if (fat_entry((u8 *) img.data(), cluster) != 0)
+         r.cluster_hashes.push_back(hashes[cluster]);
+   }
+
+   for (int i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (img[i] == 0)
+         break;
+      if (!dir_entry_used((u8 *) img.data(), i))
+         continue;
+
+      char name[20];
+      dir_entry_name((u8 *) img.data(), i, name);
+
+      uint32_t hash = fnv1a((const uint8_t *) name, INDEX_NAME_SIZE);
+      int cluster = img[i + DIR_START_CLUSTER] + (img[i + DIR_START_CLUSTER + 1] << 8);
+
+      for (int steps = 0; fat_valid_cluster(cluster) && (steps < FAT_ENTRIES_32K); steps++)
+      {
+         hash = (hash ^ hashes[cluster]) * 16777619u;
+         cluster = fat_entry((u8 *) img.data(), cluster);
+      }
+      r.file_hashes.push_back(hash);
+      r.files++;
+   }
+}
+
+// get_buffer_directory() works on bram_buffer and the global dir_entry[]
+//
+static void measure_directory(const bytes & img, image_result & r)
+{
+int scanned = 0;
+
+   memcpy(bram_buffer, img.data(), IMAGE_SIZE);
+
+   // the parser stops at the first unused entry
+   for (int i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      scanned += FAT_DIR_ENTRY_SIZE;
+      if (img[i] == 0)
+         break;
+   }
+
+   clock_type::time_point start = clock_type::now();
+   for (int i = 0; i < PARSE_REPEATS; i++)
+      get_buffer_directory();
+   r.dir_mb_s = (PARSE_REPEATS * (double) scanned) / (seconds_since(start) * 1e6);
+}
+
+
+static bool read_image(const std::string & path, bytes & img)
+{
+FILE * f = fopen(path.c_str(), "rb");
+
+   if (f == NULL)
+      return(false);
+
+   img.resize(IMAGE_SIZE + 1);
+   size_t n = fread(img.data(), 1, img.size(), f);
+   fclose(f);
+
+   img.resize(n);
+   return(n == IMAGE_SIZE);
+}
+
+// the share of 'items' whose hash was already seen in an earlier image
+//
+static double duplicate_share(const std::vector<image_result> & results,
+                              std::vector<uint32_t> image_result::* items, size_t & total)
+{
+std::set<uint32_t> seen;
+size_t dups = 0;
+
+   total = 0;
+   for (const image_result & r : results)
+   {
+      std::set<uint32_t> mine;
+
+      for (uint32_t h : r.*items)
+      {
+         total++;
+         if (seen.count(h))
+            dups++;
+         mine.insert(h);
+      }
+      seen.insert(mine.begin(), mine.end());
+   }
+   return(total ? ((dups * 100.0) / total) : 0);
+}
+
+static void usage(void)
+{
+   printf("Usage:\n");
+   printf("   corpus [-j <jobs>] [-q] <directory of 32KB BRAM dumps>\n");
+   printf("\n");
+   printf("   -q prints only the corpus summary, not each image\n");
+}
+
+int main(int argc, char *argv[])
+{
+int jobs = std::thread::hardware_concurrency();
+bool quiet = false;
+std::string dirname;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc))
+         jobs = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-q") == 0)
+         quiet = true;
+      else if ((argv[i][0] != '-') && dirname.empty())
+         dirname = argv[i];
+      else
+      {
+         usage();
+         return(1);
+      }
+   }
+
+   if (dirname.empty())
+   {
+      usage();
+      return(1);
+   }
+
+   std::vector<std::string> names;
+   DIR * dir = opendir(dirname.c_str());
+   struct dirent * ent;
+
+   if (dir == NULL)
+   {
+      fprintf(stderr, "Error: cannot open %s\n", dirname.c_str());
+      return(1);
+   }
+   while ((ent = readdir(dir)) != NULL)
+   {
+      if (ent->d_name[0] != '.')
+         names.push_back(ent->d_name);
+   }
+   closedir(dir);
+   std::sort(names.begin(), names.end());
+
+   std::vector<bytes> images;
+   std::vector<image_result> results;
+
+   for (const std::string & n : names)
+   {
+      bytes img;
+
+      if (!read_image(dirname + "/" + n, img))
+      {
+         fprintf(stderr, "skipped %s: not a 32KB image\n", n.c_str());
+         continue;
+      }
+      images.push_back(img);
+      results.push_back(image_result());
+      results.back().name = n;
+   }
+
+   if (images.empty())
+   {
+      fprintf(stderr, "Error: no 32KB images in %s\n", dirname.c_str());
+      return(1);
+   }
+
+   crc32_init();
+
+   if (jobs < 1)
+      jobs = 1;
+
+   // per-image work in parallel; each worker takes the next image
+   //
+   clock_type::time_point start = clock_type::now();
+   std::atomic<size_t> next(0);
+   std::vector<std::thread> workers;
+
+   auto worker = [&]() {
+      size_t n;
+      while ((n = next++) < images.size())
+         measure_image(images[n], results[n]);
+   };
+
+   for (int i = 1; i < jobs; i++)
+      workers.emplace_back(worker);
+   worker();
+   for (std::thread & t : workers)
+      t.join();
+
+   for (size_t n = 0; n < images.size(); n++)
+   {
+      if (results[n].valid)
+         measure_directory(images[n], results[n]);
+   }
+
+   double elapsed = seconds_since(start);
+
+   // per image
+   //
+   size_t valid = 0;
+   size_t enc_total[ENC_COUNT] = { 0 };
+   double free_sum = 0, dir_sum = 0;
+   double decode_sum[ENC_COUNT] = { 0 };
+
+   if (!quiet)
+   {
+      printf("%-24s %5s %6s %9s %9s", "image", "files", "free", "free MB/s", "dir MB/s");
+      for (int e = 1; e < ENC_COUNT; e++)
+         printf(" %9s", enc_name[e]);
+      printf("\n");
+   }
+
+   for (const image_result & r : results)
+   {
+      if (!r.valid)
+      {
+         if (!quiet)
+            printf("%-24s not formatted\n", r.name.c_str());
+         continue;
+      }
+
+      valid++;
+      free_sum += r.free_mb_s;
+      dir_sum  += r.dir_mb_s;
+      for (int e = 0; e < ENC_COUNT; e++)
+      {
+         enc_total[e]  += r.enc_size[e];
+         decode_sum[e] += r.decode_mb_s[e];
+      }
+
+      if (!quiet)
+      {
+         printf("%-24s %5d %6d %9.1f %9.1f", r.name.c_str(), r.files, r.free_bytes, r.free_mb_s, r.dir_mb_s);
+         for (int e = 1; e < ENC_COUNT; e++)
+            printf(" %8.1f%%", (r.enc_size[e] * 100.0) / IMAGE_SIZE);
+         printf("\n");
+      }
+   }
+
+   if (valid == 0)
+   {
+      fprintf(stderr, "Error: none of the images is formatted\n");
+      return(1);
+   }
+
+   // corpus
+   //
+   size_t clusters, files;
+   double cluster_dups = duplicate_share(results, &image_result::cluster_hashes, clusters);
+   double file_dups    = duplicate_share(results, &image_result::file_hashes, files);
+
+   std::set<uint32_t> whole;
+   for (size_t n = 0; n < images.size(); n++)
+   {
+      if (results[n].valid)
+         whole.insert(fnv1a(images[n].data(), IMAGE_SIZE));
+   }
+
+   printf("\n%zu images (%zu formatted), %d threads, %.2f s\n", images.size(), valid, jobs, elapsed);
+   printf("parsers (mean):  free space %.1f MB/s, directory %.1f MB/s\n", free_sum / valid, dir_sum / valid);
+
+   printf("\n%-10s %12s %8s %14s\n", "encoding", "bytes", "ratio", "decode MB/s");
+   for (int e = 0; e < ENC_COUNT; e++)
+   {
+      printf("%-10s %12zu %7.1f%% %14.1f\n", enc_name[e], enc_total[e],
+             (enc_total[e] * 100.0) / (valid * IMAGE_SIZE), decode_sum[e] / valid);
+   }
+
+   printf("\nduplicates:  %.1f%% of %zu allocated clusters, %.1f%% of %zu files, %zu of %zu images\n",
+          cluster_dups, clusters, file_dups, files, valid - whole.size(), valid);
+
+   return(0);
+}
@@ -0,0 +1,169 @@
+/*
+ *   flash.c - FX-Flash cart slots, and programming of the flash chip
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include "flash.h"
+#include "telemetry.h"
+
+void (*flash_progress)(int done, int total);
+u32  (*flash_clock)(void);
+u32  flash_busy_ticks;
+
+u32  crc_table[256];
+
+u8 * calc_bank_addr(int banknum)
+{
+   int offset;
+
+   offset = (FLASH_BANK_BASE + (banknum * FLASH_BANK_SIZE)) * 2;
+
+   return(fxbmp_mem + offset);
+}
+
+u8 * calc_bank_annotate_addr(int banknum)
+{
+   int offset;
+
+   offset = (FLASH_BANK_BASE + (banknum * FLASH_BANK_SIZE) + FLASH_BANK_CMNT) * 2;
+
+   return(fxbmp_mem + offset);
+}
+
+// erase one sector, counting it in the telemetry;
+// returns 0, or -1 if the chip did not finish in time
+//
+int flash_erase(u8 * sector)
+{
+u32 start = 0;
+u32 ticks = 0;
+int result;
+
+   if (flash_clock)
+      start = flash_clock();
+
+   result = flash_erase_sector(sector);
+
+   if (flash_clock)
+      ticks = flash_clock() - start;
+   flash_busy_ticks += ticks;
+
+   telemetry_erase(((sector - fxbmp_mem) >> 1) / FLASH_SECTOR_SIZE, ticks, result != 0);
+
+   return(result);
+}
+
+// erase the sectors holding 'len' bytes from 'target', which is
+// at the start of a sector; returns the number which timed out
+//
+int flash_erase_range(u8 * target, int len)
+{
+int i;
+int failed = 0;
+
+   for (i = 0; i < len; i += FLASH_SECTOR_SIZE)
+   {
+      if (flash_progress)
+         flash_progress(i, len);
+
+      if (flash_erase( target + (i<<1)) != 0)
+         failed++;
+   }
+
+   return(failed);
+}
+
+// program 'len' bytes from 'source' into (erased) flash at 'target',
+// timing each TELEMETRY_BLOCK of bytes; returns the number of bytes
+// which timed out
+//
+int flash_program(u8 * target, u8 * source, int len)
+{
+int i;
+int failed = 0;
+int block_failed = 0;
+u32 start = 0;
+u32 paused = 0;
+u32 ticks = 0;
+
+   for (i = 0; i < len; i++)
+   {
+      // the progress display is not part of the programming time
+      if (flash_progress && ((i & 31) == 0))
+      {
+         if (flash_clock)
+            paused = flash_clock();
+
+         flash_progress(i, len);
+
+         if (flash_clock)
+            start += flash_clock() - paused;
+      }
+
+      if (flash_clock && ((i % TELEMETRY_BLOCK) == 0))
+         start = flash_clock();
+
+      if (flash_write( (target + (i<<1)), source[i]) != 0)
+         block_failed++;
+
+      if (((i % TELEMETRY_BLOCK) == (TELEMETRY_BLOCK - 1)) || (i == (len - 1)))
+      {
+         if (flash_clock)
+            ticks = flash_clock() - start;
+         flash_busy_ticks += ticks;
+
+         telemetry_program((i % TELEMETRY_BLOCK) + 1, ticks, block_failed);
+         failed += block_failed;
+         block_failed = 0;
+      }
+   }
+
+   return(failed);
+}
+
+void crc32_init(void)
+{
+int i, j;
+u32 c;
+
+   for (i = 0; i < 256; i++)
+   {
+      c = i;
+      for (j = 0; j < 8; j++)
+         c = (c & 1) ? ((c >> 1) ^ 0xEDB88320) : (c >> 1);
+      crc_table[i] = c;
+   }
+}
+
+u32 crc32_buffer(u8 * buf, int len)
+{
+u32 crc;
+int i;
+
+   crc = 0xFFFFFFFF;
+   for (i = 0; i < len; i++)
+      crc = crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+
+   return(~crc);
+}
+
+// CRC-32 stored with a slot's data when it was saved;
+// returns 0 if the slot was saved without one
+//
+int slot_crc(int slot, u32 * crc)
+{
+u8 * meta;
+int i;
+
+   meta = calc_bank_annotate_addr(slot) + (CRC_OFFSET * 2);
+
+   if ((BUS_READ(meta) != 'C') || (BUS_READ(meta + 2) != 'K'))
+      return(0);
+
+   *crc = 0;
+   for (i = 0; i < 4; i++)
+      *crc |= (u32) BUS_READ(meta + 4 + (i * 2)) << (i * 8);
+
+   return(1);
+}
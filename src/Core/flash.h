@@ -0,0 +1,57 @@
+/*
+ *   flash.h - layout of the FX-Flash cart, and programming of its flash
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#include "hal.h"
+
+#define FLASH_SECTOR_SIZE 4096           // erase unit of the SST39SF040
+
+// the cart's reserved area: boot sector, program (from 0x1000), then these
+// sectors - shared by bank.c, the telemetry and mkcart
+//
+#define OVERLAY_FLASH    0x10000         // overlay of cold screens (bank.c)
+#define OVERLAY_FLASH_SIZE 0x2000        // including its header
+#define OVERLAY_HEADER   12              // 'O','V','L',0, then length and byte sum (little-endian)
+#define CONFIG_FLASH     0x12000         // settings sector (bank.c)
+#define TELEMETRY_FLASH  0x13000         // flash chip health record (telemetry.h)
+#define FLASH_BANK_BASE  81920           // within FX-BMP cart, start of 'slot' storage
+#define FLASH_BANK_SIZE  (36 * 1024)     // size of 'slot' (32KB for data + 4KB for date/comment metadata)
+#define FLASH_BANK_CMNT  (32 * 1024)     // location of metadata within slot
+#define COMMENT_OFFSET   12              // Ddate is at the start of metadata; this is start of Comment location
+
+#define COMMENT_LENGTH   18
+
+#define CRC_OFFSET       48              // 'C','K', then CRC-32 of the slot's 32KB (within metadata)
+#define INDEX_OFFSET     64              // directory-name index within metadata (after date/comment)
+#define INDEX_NAMES      (INDEX_OFFSET + 4)  // index magic 'I','X', name count, then names
+#define INDEX_NAME_SIZE  17              // bytes of each name stored (same as dir_entry[] text)
+
+#define MAX_SLOTS        12              // 12 slots fit in a 512KB Flash chip
+
+// called (if set) as flash_erase_range() and flash_program() go along
+extern void (*flash_progress)(int done, int total);
+
+// if set, a running count of timer ticks, for timing erases and
+// programming in the telemetry (see telemetry.h)
+extern u32  (*flash_clock)(void);
+
+// flash_clock() ticks spent in flash_erase() and flash_program() so far
+extern u32  flash_busy_ticks;
+
+extern u32  crc_table[256];
+
+u8 * calc_bank_addr(int banknum);
+u8 * calc_bank_annotate_addr(int banknum);
+int  flash_erase(u8 * sector);
+int  flash_erase_range(u8 * target, int len);
+int  flash_program(u8 * target, u8 * source, int len);
+void crc32_init(void);
+u32  crc32_buffer(u8 * buf, int len);
+int  slot_crc(int slot, u32 * crc);
+
+#endif
@@ -12,23 +12,34 @@
         /* could be made smarter to omit if not required */
 .endm
 
+.include "icache.inc"
+
 #===============================
 
      .global _flash_erase_sector
      .global _flash_write
      .global _flash_id
+     .global _icache_clear
 
 
 .equiv r_tmp,    r8
 .equiv r_cmd,    r9
 .equiv r_base1,  r10
 .equiv r_base2,  r11
+.equiv r_polls,  r12
+
+# Status polls before giving up on the chip (about 1us each): some
+# 10 times the datasheet's maximum erase (25ms) and program (20us) times
+#
+.equiv ERASE_POLLS, 0x40000
+.equiv WRITE_POLLS, 0x400
 
 #
 #  flash_erase_sector(addr);
 #
 #    Erases a 4KB sector of a SST39SF040
 #    'addr' points to any address within the memory range
+#    Returns 0, or -1 if the chip did not finish within ERASE_POLLS
 #
 _flash_erase_sector:
     #
@@ -55,14 +66,23 @@ _flash_erase_sector:
     st.b r_cmd, 0[r6]            # save to the location in the appropriate sector address
 
     movw 0xFF, r7                # erased data should show as 0xFF when complete
+    movw ERASE_POLLS, r_polls
 
 eraseloop:    
     ld.b 0[r6], r_cmd            # check the value at the original location
     and  r7, r_cmd               # ensure only lowest 8 bits are relevant
 
-    cmp  r7, r_cmd               # loop if it's not done yet
+    cmp  r7, r_cmd               # done ?
+    be   erasedone
+    add  -1, r_polls             # loop if it's not done yet, and not timed out
     bne  eraseloop
 
+    mov  -1, r10
+    mov  r18, lp
+    jmp  [lp]
+
+erasedone:
+    mov  0, r10
     mov  r18, lp
     jmp  [lp]
     
@@ -75,6 +95,8 @@ eraseloop:
 #    'addr' points to any address within the memory range
 #           (Note: must not have been written previously)
 #    'data' is the value to write at that location
+#    Returns 0, or -1 if the chip did not finish within WRITE_POLLS
+#    (which is also what happens if a bit cannot be programmed)
 #
 _flash_write:
     #
@@ -97,14 +119,23 @@ _flash_write:
     and  r_tmp, r7
 
     st.b r7, 0[r6]
+    movw WRITE_POLLS, r_polls
 
 checkloop:    
     ld.b 0[r6], r_cmd            # check the value at the original location
     and  r_tmp, r_cmd            # ensure only lowest 8 bits are relevant
 
-    cmp  r7, r_cmd               # loop if it's not done yet
+    cmp  r7, r_cmd               # done ?
+    be   writedone
+    add  -1, r_polls             # loop if it's not done yet, and not timed out
     bne  checkloop
 
+    mov  -1, r10
+    mov  r18, lp
+    jmp  [lp]
+
+writedone:
+    mov  0, r10
     mov  r18, lp
     jmp  [lp]
 
@@ -155,3 +186,17 @@ _flash_id:
     jmp  [lp]
 
 #-----------------------------------
+
+
+#-----------------------------------
+#
+#  icache_clear();
+#
+#    Clears all 128 entries of the V810 instruction cache, after
+#    code has been copied into RAM (overlays), keeping the cache
+#    enable bit as it was
+#
+_icache_clear:
+    icache_clear_all r_tmp
+
+    jmp  [lp]
@@ -0,0 +1,125 @@
+/*
+ *   hal.h - what the core library needs from the machine it runs on
+ *
+ *   On the PC-FX, the memory windows are the addresses given in
+ *   backup.s, and the flash functions are those in flashfuncs.s.
+ *
+ *   In a host build (HOST_BUILD), internal backup memory and the
+ *   buffers are plain arrays (host.c), and the cart is the flash
+ *   chip model in Host_Tools/flashsim.cpp - which has the same
+ *   stride-2 window and the same flash functions.
+ *
+ *   The display, joypad, timer and interrupts of the PC-FX are in
+ *   console.c, which is not part of host builds.
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef HOST_BUILD
+
+#include <stdint.h>
+#include "../Host_Tools/flashsim.h"
+
+typedef uint8_t   u8;
+typedef uint16_t  u16;
+typedef uint32_t  u32;
+typedef uint64_t  u64;
+typedef int8_t    s8;
+typedef int16_t   s16;
+typedef int32_t   s32;
+
+extern u8 host_bram_mem[];      // 32KB at every second byte, as at 0xE0000000
+extern u8 host_bram_buffer[];
+extern u8 host_diff_buffer[];
+
+#define bram_mem     host_bram_mem
+#define fxbmp_mem    (flashsim_window())
+#define bram_buffer  host_bram_buffer
+#define diff_buffer  host_diff_buffer
+
+// reads of the cart go through the flash model, so that they are counted
+u8 host_bus_read(const u8 * addr);
+#define BUS_READ(addr)  host_bus_read(addr)
+
+#else
+
+#include <eris/types.h>
+
+extern u8 bram_mem[];           // internal backup memory (0xE0000000), at every second byte
+extern u8 fxbmp_mem[];          // external backup memory (0xE8000000), at every second byte
+extern u8 bram_buffer[];        // 32KB working image
+extern u8 diff_buffer[];        // second 32KB image, for comparisons
+
+// these return 0, or -1 if the chip did not finish in time
+extern int  flash_erase_sector( u8 * sector);
+extern int  flash_write( u8 * addr, u8 value);
+extern void flash_id( u8 * addr );
+
+#define BUS_READ(addr)  (*(addr))
+
+// display, joypad, timer and interrupts (console.c)
+
+#define JOY_I            1
+#define JOY_II           2
+#define JOY_III          4
+#define JOY_IV           8
+#define JOY_V            16
+#define JOY_VI           32
+#define JOY_SELECT       64
+#define JOY_RUN          128
+#define JOY_UP           256
+#define JOY_RIGHT        512
+#define JOY_DOWN         1024
+#define JOY_LEFT         2048
+#define JOY_MODE1        4096
+#define JOY_MODE2        16384
+
+#define BAT_WIDTH        64              // 7up background map is 64x32 cells
+#define BAT_HEIGHT       32
+#define BAT_BLANK        0x120           // space character, palette 0
+
+#define REPEAT_DELAY     20              // frames a direction is held before the first repeat
+#define REPEAT_RATE      4               // frames between repeats after that
+
+extern u16 font[];              // each program's font.s: 0x60 characters, in 7up tile format
+
+extern volatile int sda_frame_count;
+extern volatile u32 joypad;     // held now
+extern u32 joytrg;              // pressed (or repeated) - one event per vsync()
+extern int repeat_delay;
+extern int repeat_rate;
+extern u32 boot_ticks;          // set by each program once its first menu is shown
+
+// called by vsync(): at the start of vblank (after the BAT is sent), and
+// before it waits - with its caller, and whether the vblank had already gone
+extern void (*vsync_hook)(void);
+extern void (*frame_end_hook)(u32 caller, int late);
+
+#ifdef PROFILE
+extern u32 print_busy_ticks;    // timer ticks spent in print_at()
+#endif
+
+void console_init(int bg0_lines, int sprites);
+void vsync(int numframes);
+u32  ticks_now(void);
+u32  input_next(void);
+void input_flush(void);
+
+void print_at(int x, int y, int pal, char* str);
+void putch_at(int x, int y, int pal, char c);
+void putnumber_at(int x, int y, int pal, int digits, int value);
+void bat_flush(void);
+
+void sup_vram_block(u16 addr, u16 * src, int count);
+void sup_vram_fill(u16 addr, u16 value, int count);
+void king_kram_fill(u32 addr, u16 value, int count);
+
+#endif
+
+// flash_clock() on the PC-FX is the free-running timer: CPU clock / 15
+#define TIMER_TICKS_PER_MS  1432        // 21.477MHz / 15 / 1000
+
+#endif
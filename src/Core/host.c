@@ -0,0 +1,23 @@
+/*
+ *   host.c - memories for a host build of the core library (HOST_BUILD)
+ *
+ *   The cart itself is the flash model in Host_Tools/flashsim.cpp.
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include "hal.h"
+
+u8 host_bram_mem[32768 * 2];
+u8 host_bram_buffer[32768];
+u8 host_diff_buffer[32768];
+
+u8 host_bus_read(const u8 * addr)
+{
+const u8 * window = flashsim_window();
+
+   if ((addr >= window) && (addr < window + FLASHSIM_WINDOW))
+      return(flashsim_bus_read(addr - window));
+
+   return(*addr);
+}
@@ -0,0 +1,265 @@
+/*
+ *   telemetry.c - wear and health record of the cart's flash chip
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#include <string.h>
+
+#include "flash.h"
+#include "telemetry.h"
+
+#define TELEMETRY_VERSION     2          // 2: counts stored complemented
+#define TELEMETRY_TOTALS      4          // after 'T','L',version
+#define TELEMETRY_RECORDS     1024       // first record
+#define TELEMETRY_RECORD_SIZE 64
+#define TELEMETRY_MAX_RECORDS ((FLASH_SECTOR_SIZE - TELEMETRY_RECORDS) / TELEMETRY_RECORD_SIZE)
+
+// a record - counts since the one before it
+//
+// Counts (in the totals too) are stored complemented, so that a count of
+// zero is left as erased flash: only the bytes of counts which changed
+// are programmed.  The 'T','L',version header and the mark are not.
+//
+#define REC_MARK              0          // 'R' (still 0xFF while the record is free)
+#define REC_ERASE_TIMEOUTS    1
+#define REC_PROGRAM_TIMEOUTS  2
+#define REC_VERIFY_FAILURES   3
+#define REC_ERASED            4          // bitmap of the sectors erased
+#define REC_ERASE_HIST        20         // a byte for each bucket
+#define REC_PROGRAM_HIST      28         // two bytes (little-endian) for each bucket
+#define REC_LENGTH            44         // (the rest is left erased)
+
+#define TELEMETRY_ADDR(offset)  (fxbmp_mem + ((TELEMETRY_FLASH + (offset)) * 2))
+
+const u16 erase_bucket_ms[TELEMETRY_BUCKETS]   = { 0, 15, 18, 21, 25, 30, 50, 100 };
+const u16 program_bucket_us[TELEMETRY_BUCKETS] = { 0, 10, 14, 17, 20, 25, 40, 80 };
+
+static u8  pending[REC_LENGTH];          // the record being gathered
+static int pending_used = 0;
+static struct telemetry totals;          // for rewriting the sector when it is full
+
+
+static int bucket(const u16 * lowest, u32 value)
+{
+int i;
+
+   for (i = TELEMETRY_BUCKETS - 1; i > 0; i--)
+   {
+      if (value >= lowest[i])
+         break;
+   }
+   return(i);
+}
+
+// add to a byte of the pending record, writing
+// the record out first if the byte would overflow
+//
+static void pending_add(int offset, u32 n)
+{
+u32 room;
+
+   while (n > 0)
+   {
+      if (pending[offset] == 255)
+         telemetry_flush();
+
+      room = 255 - pending[offset];
+      if (room > n)
+         room = n;
+
+      pending[offset] += room;
+      pending_used = 1;
+      n -= room;
+   }
+}
+
+void telemetry_erase(int sector, u32 ticks, int timed_out)
+{
+u8 bit;
+
+   sector &= FLASH_SECTORS - 1;
+   bit = 1 << (sector & 7);
+
+   if (pending[REC_ERASED + (sector >> 3)] & bit)     // already erased once in this record
+      telemetry_flush();
+
+   pending[REC_ERASED + (sector >> 3)] |= bit;
+   pending_used = 1;
+
+   if (timed_out)
+      pending_add(REC_ERASE_TIMEOUTS, 1);
+   else if (flash_clock)
+      pending_add(REC_ERASE_HIST + bucket(erase_bucket_ms, ticks / TIMER_TICKS_PER_MS), 1);
+}
+
+void telemetry_program(int bytes, u32 ticks, int timeouts)
+{
+int offset;
+u32 count;
+
+   if (timeouts)
+      pending_add(REC_PROGRAM_TIMEOUTS, timeouts);
+
+   if (!flash_clock || (bytes <= 0))
+      return;
+
+   offset = REC_PROGRAM_HIST + (bucket(program_bucket_us, (ticks * 1000) / (TIMER_TICKS_PER_MS * bytes)) * 2);
+   count = pending[offset] | (pending[offset + 1] << 8);
+
+   if (count == 0xFFFF)
+   {
+      telemetry_flush();
+      count = 0;
+   }
+
+   count++;
+   pending[offset]     = count & 0xFF;
+   pending[offset + 1] = count >> 8;
+   pending_used = 1;
+}
+
+void telemetry_verify_failure(void)
+{
+   pending_add(REC_VERIFY_FAILURES, 1);
+}
+
+static int log_valid(void)
+{
+   return((BUS_READ(TELEMETRY_ADDR(0)) == 'T') && (BUS_READ(TELEMETRY_ADDR(1)) == 'L') &&
+          (BUS_READ(TELEMETRY_ADDR(2)) == TELEMETRY_VERSION));
+}
+
+static int sector_blank(void)
+{
+int i;
+
+   for (i = 0; i < FLASH_SECTOR_SIZE; i++)
+   {
+      if (BUS_READ(TELEMETRY_ADDR(i)) != 0xFF)
+         return(0);
+   }
+   return(1);
+}
+
+// counts are written complemented; bytes which are zero are
+// already as erased, and are not programmed
+//
+static void write_counts(int offset, u8 * src, int len)
+{
+int i;
+
+   for (i = 0; i < len; i++)
+   {
+      if (src[i] != 0)
+         flash_write(TELEMETRY_ADDR(offset + i), ~src[i]);
+   }
+}
+
+static u8 read_count(u8 * addr)
+{
+   return(~BUS_READ(addr));
+}
+
+static void write_totals(void)
+{
+   flash_write(TELEMETRY_ADDR(0), 'T');
+   flash_write(TELEMETRY_ADDR(1), 'L');
+   flash_write(TELEMETRY_ADDR(2), TELEMETRY_VERSION);
+   write_counts(TELEMETRY_TOTALS, (u8 *) &totals, sizeof(totals));
+}
+
+// append the pending record (if anything has happened)
+//
+void telemetry_flush(void)
+{
+int slot;
+
+   if (!pending_used)
+      return;
+
+   if (!log_valid())
+   {
+      if (sector_blank())
+      {
+         memset(&totals, 0, sizeof(totals));
+         write_totals();
+      }
+      else
+      {
+         memset(pending, 0, sizeof(pending));     // not ours: nothing is recorded
+         pending_used = 0;
+         return;
+      }
+   }
+
+   for (slot = 0; slot < TELEMETRY_MAX_RECORDS; slot++)
+   {
+      if (BUS_READ(TELEMETRY_ADDR(TELEMETRY_RECORDS + (slot * TELEMETRY_RECORD_SIZE))) == 0xFF)
+         break;
+   }
+
+   // full: add the records into the totals, and start the sector again
+   if (slot == TELEMETRY_MAX_RECORDS)
+   {
+      telemetry_read(&totals);
+      totals.erase_count[TELEMETRY_SECTOR]++;
+      totals.compactions++;
+
+      flash_erase_sector(TELEMETRY_ADDR(0));
+      write_totals();
+      slot = 0;
+   }
+
+   flash_write(TELEMETRY_ADDR(TELEMETRY_RECORDS + (slot * TELEMETRY_RECORD_SIZE)), 'R');
+   write_counts(TELEMETRY_RECORDS + (slot * TELEMETRY_RECORD_SIZE) + 1, &pending[1], REC_LENGTH - 1);
+
+   memset(pending, 0, sizeof(pending));
+   pending_used = 0;
+}
+
+// the totals, with every record added in; returns the number of
+// records, or -1 if the cart holds no telemetry
+//
+int telemetry_read(struct telemetry * t)
+{
+u8 * dest = (u8 *) t;
+u8 * rec;
+int slot;
+int i;
+
+   memset(t, 0, sizeof(*t));
+
+   if (!log_valid())
+      return(-1);
+
+   for (i = 0; i < sizeof(*t); i++)
+      dest[i] = read_count(TELEMETRY_ADDR(TELEMETRY_TOTALS + i));
+
+   for (slot = 0; slot < TELEMETRY_MAX_RECORDS; slot++)
+   {
+      rec = TELEMETRY_ADDR(TELEMETRY_RECORDS + (slot * TELEMETRY_RECORD_SIZE));
+
+      if (BUS_READ(rec) != 'R')
+         break;
+
+      for (i = 0; i < FLASH_SECTORS; i++)
+      {
+         if (read_count(rec + ((REC_ERASED + (i >> 3)) * 2)) & (1 << (i & 7)))
+            t->erase_count[i]++;
+      }
+
+      for (i = 0; i < TELEMETRY_BUCKETS; i++)
+      {
+         t->erase_hist[i]   += read_count(rec + ((REC_ERASE_HIST + i) * 2));
+         t->program_hist[i] += read_count(rec + ((REC_PROGRAM_HIST + (i * 2)) * 2)) |
+                               (read_count(rec + ((REC_PROGRAM_HIST + (i * 2) + 1) * 2)) << 8);
+      }
+
+      t->erase_timeouts   += read_count(rec + (REC_ERASE_TIMEOUTS * 2));
+      t->program_timeouts += read_count(rec + (REC_PROGRAM_TIMEOUTS * 2));
+      t->verify_failures  += read_count(rec + (REC_VERIFY_FAILURES * 2));
+   }
+
+   return(slot);
+}
@@ -0,0 +1,53 @@
+/*
+ *   telemetry.h - wear and health record of the cart's flash chip
+ *
+ *   One sector of the cart (TELEMETRY_FLASH) keeps the number of times
+ *   each sector has been erased, histograms of how long sector erases and
+ *   programming took, and counts of operations which timed out and of
+ *   slots which failed their CRC check - so that a chip which is wearing
+ *   out shows up before it loses data.
+ *
+ *   The sector holds a block of totals, followed by records appended as
+ *   the cart is used (one per operation, so only a few bytes are
+ *   programmed each time: counts are stored complemented, so those
+ *   which are still zero are left erased); when it is full, the records are added into
+ *   the totals, and the sector is erased and rewritten.  Nothing is
+ *   recorded if the sector holds something else (a larger program), and
+ *   erasing the whole cart starts the record again.
+ *
+ *   Copyright (C) 2022, 2023 David Shadoff
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "hal.h"
+#include "flash.h"
+
+#define TELEMETRY_SECTOR     (TELEMETRY_FLASH / FLASH_SECTOR_SIZE)
+#define FLASH_SECTORS        128         // 512KB in 4KB sectors
+
+#define TELEMETRY_BUCKETS    8
+#define TELEMETRY_BLOCK      256         // programming is timed over this many bytes
+
+struct telemetry
+{
+   u32 erase_count[FLASH_SECTORS];
+   u32 erase_hist[TELEMETRY_BUCKETS];     // sector erase times, from erase_bucket_ms[]
+   u32 program_hist[TELEMETRY_BUCKETS];   // programming time per byte, from program_bucket_us[]
+   u32 erase_timeouts;
+   u32 program_timeouts;                  // bytes
+   u32 verify_failures;                   // slots whose data did not match their CRC
+   u32 compactions;                       // times the telemetry sector was full
+};
+
+extern const u16 erase_bucket_ms[TELEMETRY_BUCKETS];     // lowest time in each bucket
+extern const u16 program_bucket_us[TELEMETRY_BUCKETS];
+
+void telemetry_erase(int sector, u32 ticks, int timed_out);
+void telemetry_program(int bytes, u32 ticks, int timeouts);
+void telemetry_verify_failure(void);
+void telemetry_flush(void);
+int  telemetry_read(struct telemetry * t);
+
+#endif
@@ -1,107 +1,133 @@
 # 8x8 monochrome font(s)
+#
+# Each character is assembled directly into the 7up background
+# tile format, so that init() can copy the whole font into VRAM
+# as one block:
+#   8 words of planes 0/1 - the font bits in plane 0 (color 1 = foreground)
+#                           and their inverse in plane 1 (color 2 = background)
+#   8 words of planes 2/3 - always zero
+
+.macro  glyph_row bits
+	.hword  ((~(\bits) & 0xff) << 8) | (\bits)
+.endm
+
+.macro  glyph b0, b1, b2, b3, b4, b5, b6, b7
+	glyph_row \b0
+	glyph_row \b1
+	glyph_row \b2
+	glyph_row \b3
+	glyph_row \b4
+	glyph_row \b5
+	glyph_row \b6
+	glyph_row \b7
+	.rept 8
+	.hword  0
+	.endr
+.endm
 
 	.global _font
 
+	.balign 2
 _font:
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	# SPACE
-	.byte 0x18,0x18,0x18,0x10,0x10,0x00,0x18,0x00	# !
-	.byte 0x6c,0x6c,0xd8,0x00,0x00,0x00,0x00,0x00	# "
-	.byte 0x6c,0xfe,0x6c,0x6c,0x6c,0xfe,0x6c,0x00	# #
-	.byte 0x10,0x38,0x40,0x38,0x04,0x38,0x10,0x00	# 0x
-	.byte 0x42,0xa4,0x48,0x10,0x24,0x4a,0x84,0x00	# %
-	.byte 0x20,0x50,0x20,0x54,0x88,0x94,0x62,0x00	# &
-	.byte 0x18,0x30,0x60,0x00,0x00,0x00,0x00,0x00	# '
-	.byte 0x18,0x30,0x60,0x60,0x60,0x30,0x18,0x00	# (
-	.byte 0x30,0x18,0x0c,0x0c,0x0c,0x18,0x30,0x00	# )
-	.byte 0x54,0x38,0x7c,0x38,0x54,0x00,0x00,0x00	# *
-	.byte 0x00,0x10,0x10,0x7c,0x10,0x10,0x00,0x00	# +
-	.byte 0x00,0x00,0x00,0x18,0x18,0x08,0x10,0x00	# ,
-	.byte 0x00,0x00,0x00,0x78,0x00,0x00,0x00,0x00	# -
-	.byte 0x00,0x00,0x00,0x00,0x60,0x60,0x00,0x00	# .
-	.byte 0x06,0x0c,0x18,0x30,0x60,0xc0,0x00,0x00	# /
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	# SPACE
+	glyph 0x18,0x18,0x18,0x10,0x10,0x00,0x18,0x00	# !
+	glyph 0x6c,0x6c,0xd8,0x00,0x00,0x00,0x00,0x00	# "
+	glyph 0x6c,0xfe,0x6c,0x6c,0x6c,0xfe,0x6c,0x00	# #
+	glyph 0x10,0x38,0x40,0x38,0x04,0x38,0x10,0x00	# 0x
+	glyph 0x42,0xa4,0x48,0x10,0x24,0x4a,0x84,0x00	# %
+	glyph 0x20,0x50,0x20,0x54,0x88,0x94,0x62,0x00	# &
+	glyph 0x18,0x30,0x60,0x00,0x00,0x00,0x00,0x00	# '
+	glyph 0x18,0x30,0x60,0x60,0x60,0x30,0x18,0x00	# (
+	glyph 0x30,0x18,0x0c,0x0c,0x0c,0x18,0x30,0x00	# )
+	glyph 0x54,0x38,0x7c,0x38,0x54,0x00,0x00,0x00	# *
+	glyph 0x00,0x10,0x10,0x7c,0x10,0x10,0x00,0x00	# +
+	glyph 0x00,0x00,0x00,0x18,0x18,0x08,0x10,0x00	# ,
+	glyph 0x00,0x00,0x00,0x78,0x00,0x00,0x00,0x00	# -
+	glyph 0x00,0x00,0x00,0x00,0x60,0x60,0x00,0x00	# .
+	glyph 0x06,0x0c,0x18,0x30,0x60,0xc0,0x00,0x00	# /
 
-	.byte 0x38,0x4c,0xc6,0xc6,0xc6,0x64,0x38,0x00	# 0
-	.byte 0x18,0x78,0x18,0x18,0x18,0x18,0x7e,0x00	# 1
-	.byte 0x7c,0xc6,0x0e,0x3c,0x78,0xe0,0xfe,0x00	# 2
-	.byte 0xfe,0x0c,0x18,0x7c,0x06,0xc6,0x7c,0x00	# 3
-	.byte 0x3c,0x6c,0xcc,0xcc,0xcc,0xfe,0x0c,0x00	# 4
-	.byte 0xfe,0xc0,0xfc,0x06,0x06,0xc6,0x7c,0x00	# 5
-	.byte 0x3c,0x60,0xc0,0xfc,0xc6,0xc6,0x7c,0x00	# 6
-	.byte 0xfe,0xc6,0x0c,0x18,0x30,0x30,0x30,0x00	# 7
-	.byte 0x7c,0xc6,0xc6,0x7c,0xc6,0xc6,0x7c,0x00	# 8
-	.byte 0x7c,0xc6,0xc6,0x7e,0x06,0x0c,0x78,0x00	# 9
-	.byte 0x00,0x18,0x18,0x00,0x18,0x18,0x00,0x00	# :
-	.byte 0x00,0x18,0x18,0x00,0x18,0x18,0x30,0x00	# ;
-	.byte 0x0c,0x18,0x30,0x60,0x30,0x18,0x0c,0x00	# <
-	.byte 0x00,0x00,0x7c,0x00,0x7c,0x00,0x00,0x00	# =
-	.byte 0x60,0x30,0x18,0x0c,0x18,0x30,0x60,0x00	# >
-	.byte 0x7c,0xc6,0x9e,0x38,0x20,0x00,0x30,0x00	# ?
+	glyph 0x38,0x4c,0xc6,0xc6,0xc6,0x64,0x38,0x00	# 0
+	glyph 0x18,0x78,0x18,0x18,0x18,0x18,0x7e,0x00	# 1
+	glyph 0x7c,0xc6,0x0e,0x3c,0x78,0xe0,0xfe,0x00	# 2
+	glyph 0xfe,0x0c,0x18,0x7c,0x06,0xc6,0x7c,0x00	# 3
+	glyph 0x3c,0x6c,0xcc,0xcc,0xcc,0xfe,0x0c,0x00	# 4
+	glyph 0xfe,0xc0,0xfc,0x06,0x06,0xc6,0x7c,0x00	# 5
+	glyph 0x3c,0x60,0xc0,0xfc,0xc6,0xc6,0x7c,0x00	# 6
+	glyph 0xfe,0xc6,0x0c,0x18,0x30,0x30,0x30,0x00	# 7
+	glyph 0x7c,0xc6,0xc6,0x7c,0xc6,0xc6,0x7c,0x00	# 8
+	glyph 0x7c,0xc6,0xc6,0x7e,0x06,0x0c,0x78,0x00	# 9
+	glyph 0x00,0x18,0x18,0x00,0x18,0x18,0x00,0x00	# :
+	glyph 0x00,0x18,0x18,0x00,0x18,0x18,0x30,0x00	# ;
+	glyph 0x0c,0x18,0x30,0x60,0x30,0x18,0x0c,0x00	# <
+	glyph 0x00,0x00,0x7c,0x00,0x7c,0x00,0x00,0x00	# =
+	glyph 0x60,0x30,0x18,0x0c,0x18,0x30,0x60,0x00	# >
+	glyph 0x7c,0xc6,0x9e,0x38,0x20,0x00,0x30,0x00	# ?
 
-	.byte 0x3c,0x42,0x9a,0xaa,0xaa,0x5c,0x00,0x00	# @
-	.byte 0x38,0x6c,0xc6,0xc6,0xfe,0xc6,0xc6,0x00	# A
-	.byte 0xfc,0xc6,0xc6,0xfc,0xc6,0xc6,0xfc,0x00	# B
-	.byte 0x3c,0x66,0xc0,0xc0,0xc0,0x66,0x3c,0x00	# C
-	.byte 0xf8,0xcc,0xc6,0xc6,0xc6,0xcc,0xf8,0x00	# D
-	.byte 0xfe,0xc0,0xc0,0xfc,0xc0,0xc0,0xfe,0x00	# E
-	.byte 0xfe,0xc0,0xc0,0xfc,0xc0,0xc0,0xc0,0x00	# F
-	.byte 0x3c,0x66,0xc0,0xce,0xc6,0x66,0x3e,0x00	# G
-	.byte 0xc6,0xc6,0xc6,0xfe,0xc6,0xc6,0xc6,0x00	# H
-	.byte 0x7e,0x18,0x18,0x18,0x18,0x18,0x7e,0x00	# I
-	.byte 0x06,0x06,0x06,0x06,0x06,0xc6,0x7c,0x00	# J
-	.byte 0xc6,0xcc,0xd8,0xf0,0xd8,0xcc,0xc6,0x00	# K
-	.byte 0xc0,0xc0,0xc0,0xc0,0xc0,0xc0,0xfe,0x00	# L
-	.byte 0x82,0xc6,0xee,0xfe,0xd6,0xc6,0xc6,0x00	# M
-	.byte 0x86,0xc6,0xe6,0xf6,0xde,0xce,0xc6,0x00	# N
-	.byte 0x7c,0xc6,0xc6,0xc6,0xc6,0xc6,0x7c,0x00	# O
+	glyph 0x3c,0x42,0x9a,0xaa,0xaa,0x5c,0x00,0x00	# @
+	glyph 0x38,0x6c,0xc6,0xc6,0xfe,0xc6,0xc6,0x00	# A
+	glyph 0xfc,0xc6,0xc6,0xfc,0xc6,0xc6,0xfc,0x00	# B
+	glyph 0x3c,0x66,0xc0,0xc0,0xc0,0x66,0x3c,0x00	# C
+	glyph 0xf8,0xcc,0xc6,0xc6,0xc6,0xcc,0xf8,0x00	# D
+	glyph 0xfe,0xc0,0xc0,0xfc,0xc0,0xc0,0xfe,0x00	# E
+	glyph 0xfe,0xc0,0xc0,0xfc,0xc0,0xc0,0xc0,0x00	# F
+	glyph 0x3c,0x66,0xc0,0xce,0xc6,0x66,0x3e,0x00	# G
+	glyph 0xc6,0xc6,0xc6,0xfe,0xc6,0xc6,0xc6,0x00	# H
+	glyph 0x7e,0x18,0x18,0x18,0x18,0x18,0x7e,0x00	# I
+	glyph 0x06,0x06,0x06,0x06,0x06,0xc6,0x7c,0x00	# J
+	glyph 0xc6,0xcc,0xd8,0xf0,0xd8,0xcc,0xc6,0x00	# K
+	glyph 0xc0,0xc0,0xc0,0xc0,0xc0,0xc0,0xfe,0x00	# L
+	glyph 0x82,0xc6,0xee,0xfe,0xd6,0xc6,0xc6,0x00	# M
+	glyph 0x86,0xc6,0xe6,0xf6,0xde,0xce,0xc6,0x00	# N
+	glyph 0x7c,0xc6,0xc6,0xc6,0xc6,0xc6,0x7c,0x00	# O
 
-	.byte 0xfc,0xc6,0xc6,0xc6,0xfc,0xc0,0xc0,0x00	# P
-	.byte 0x7c,0xc6,0xc6,0xc6,0xde,0xcc,0x76,0x00	# Q
-	.byte 0xfc,0xc6,0xc6,0xfc,0xd8,0xcc,0xc6,0x00	# R
-	.byte 0x7c,0xc6,0xf0,0x7c,0x1e,0xc6,0x7c,0x00	# S
-	.byte 0x7e,0x18,0x18,0x18,0x18,0x18,0x18,0x00	# T
-	.byte 0xc6,0xc6,0xc6,0xc6,0xc6,0xc6,0x7c,0x00	# U
-	.byte 0xc6,0xc6,0xc6,0xc6,0xc6,0x6c,0x38,0x00	# V
-	.byte 0xc6,0xc6,0xc6,0xd6,0xfe,0xee,0xc6,0x00	# W
-	.byte 0xc6,0xee,0x7c,0x38,0x7c,0xee,0xc6,0x00	# X
-	.byte 0x66,0x66,0x66,0x3c,0x18,0x18,0x18,0x00	# Y
-	.byte 0xfe,0x0e,0x1c,0x38,0x70,0xe0,0xfe,0x00	# Z
-	.byte 0x78,0x60,0x60,0x60,0x60,0x60,0x78,0x00	# [
-	.byte 0xc0,0x60,0x30,0x18,0x0c,0x06,0x00,0x00	# \
-	.byte 0x3c,0x0c,0x0c,0x0c,0x0c,0x0c,0x3c,0x00	# ]
-	.byte 0x10,0x28,0x44,0x00,0x00,0x00,0x00,0x00	# ^
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0xfe,0x00	# _
+	glyph 0xfc,0xc6,0xc6,0xc6,0xfc,0xc0,0xc0,0x00	# P
+	glyph 0x7c,0xc6,0xc6,0xc6,0xde,0xcc,0x76,0x00	# Q
+	glyph 0xfc,0xc6,0xc6,0xfc,0xd8,0xcc,0xc6,0x00	# R
+	glyph 0x7c,0xc6,0xf0,0x7c,0x1e,0xc6,0x7c,0x00	# S
+	glyph 0x7e,0x18,0x18,0x18,0x18,0x18,0x18,0x00	# T
+	glyph 0xc6,0xc6,0xc6,0xc6,0xc6,0xc6,0x7c,0x00	# U
+	glyph 0xc6,0xc6,0xc6,0xc6,0xc6,0x6c,0x38,0x00	# V
+	glyph 0xc6,0xc6,0xc6,0xd6,0xfe,0xee,0xc6,0x00	# W
+	glyph 0xc6,0xee,0x7c,0x38,0x7c,0xee,0xc6,0x00	# X
+	glyph 0x66,0x66,0x66,0x3c,0x18,0x18,0x18,0x00	# Y
+	glyph 0xfe,0x0e,0x1c,0x38,0x70,0xe0,0xfe,0x00	# Z
+	glyph 0x78,0x60,0x60,0x60,0x60,0x60,0x78,0x00	# [
+	glyph 0xc0,0x60,0x30,0x18,0x0c,0x06,0x00,0x00	# \
+	glyph 0x3c,0x0c,0x0c,0x0c,0x0c,0x0c,0x3c,0x00	# ]
+	glyph 0x10,0x28,0x44,0x00,0x00,0x00,0x00,0x00	# ^
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0xfe,0x00	# _
 
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#  
-	.byte 0x00,0x00,0x3c,0x06,0x7e,0xc6,0x7e,0x00	# a
-	.byte 0xc0,0xc0,0xfc,0xc6,0xc6,0xc6,0xfc,0x00	# b
-	.byte 0x00,0x00,0x7c,0xc6,0xc0,0xc6,0x7c,0x00	# c
-	.byte 0x06,0x06,0x7e,0xc6,0xc6,0xc6,0x7e,0x00	# d
-	.byte 0x00,0x00,0x7c,0xc6,0xfc,0xc0,0x7e,0x00	# e
-	.byte 0x3e,0x60,0x60,0xf8,0x60,0x60,0x60,0x00	# f
-	.byte 0x00,0x00,0x7c,0xc6,0xc6,0x7e,0x06,0x7c	# g
-	.byte 0xc0,0xc0,0xfc,0xc6,0xc6,0xc6,0xc6,0x00	# h
-	.byte 0x18,0x00,0x18,0x18,0x18,0x18,0x18,0x00	# i
-	.byte 0x0c,0x0c,0x00,0x0c,0x0c,0x0c,0x0c,0x78	# j
-	.byte 0xc0,0xc0,0xd8,0xf0,0xe0,0xf0,0xd8,0x00	# k
-	.byte 0x70,0x30,0x30,0x30,0x30,0x30,0x78,0x00	# l
-	.byte 0x00,0x00,0x7c,0xd6,0xd6,0xd6,0xd6,0x00	# m
-	.byte 0x00,0x00,0x7c,0x66,0x66,0x66,0x66,0x00	# n
-	.byte 0x00,0x00,0x3c,0x66,0x66,0x66,0x3c,0x00	# o
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#  
+	glyph 0x00,0x00,0x3c,0x06,0x7e,0xc6,0x7e,0x00	# a
+	glyph 0xc0,0xc0,0xfc,0xc6,0xc6,0xc6,0xfc,0x00	# b
+	glyph 0x00,0x00,0x7c,0xc6,0xc0,0xc6,0x7c,0x00	# c
+	glyph 0x06,0x06,0x7e,0xc6,0xc6,0xc6,0x7e,0x00	# d
+	glyph 0x00,0x00,0x7c,0xc6,0xfc,0xc0,0x7e,0x00	# e
+	glyph 0x3e,0x60,0x60,0xf8,0x60,0x60,0x60,0x00	# f
+	glyph 0x00,0x00,0x7c,0xc6,0xc6,0x7e,0x06,0x7c	# g
+	glyph 0xc0,0xc0,0xfc,0xc6,0xc6,0xc6,0xc6,0x00	# h
+	glyph 0x18,0x00,0x18,0x18,0x18,0x18,0x18,0x00	# i
+	glyph 0x0c,0x0c,0x00,0x0c,0x0c,0x0c,0x0c,0x78	# j
+	glyph 0xc0,0xc0,0xd8,0xf0,0xe0,0xf0,0xd8,0x00	# k
+	glyph 0x70,0x30,0x30,0x30,0x30,0x30,0x78,0x00	# l
+	glyph 0x00,0x00,0x7c,0xd6,0xd6,0xd6,0xd6,0x00	# m
+	glyph 0x00,0x00,0x7c,0x66,0x66,0x66,0x66,0x00	# n
+	glyph 0x00,0x00,0x3c,0x66,0x66,0x66,0x3c,0x00	# o
 
-	.byte 0x00,0x00,0x7c,0x66,0x66,0x7c,0x60,0x60	# p
-	.byte 0x00,0x00,0x3e,0x66,0x66,0x3e,0x06,0x06	# q
-	.byte 0x00,0x00,0xd8,0xfc,0xe0,0xc0,0xc0,0x00	# r
-	.byte 0x00,0x00,0x3c,0x60,0x38,0x0c,0x78,0x00	# s
-	.byte 0x30,0x30,0x78,0x30,0x30,0x30,0x1c,0x00	# t
-	.byte 0x00,0x00,0x66,0x66,0x66,0x66,0x3e,0x00	# u
-	.byte 0x00,0x00,0xc6,0xc6,0x6c,0x38,0x10,0x00	# v
-	.byte 0x00,0x00,0xc6,0xd6,0xd6,0xd6,0x6c,0x00	# w
-	.byte 0x00,0x00,0xc6,0x6c,0x10,0x6c,0xc6,0x00	# x
-	.byte 0x00,0x00,0x66,0x66,0x66,0x3e,0x06,0x3c	# y
-	.byte 0x00,0x00,0xfe,0x0c,0x38,0x60,0xfe,0x00	# z
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
-	.byte 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
+	glyph 0x00,0x00,0x7c,0x66,0x66,0x7c,0x60,0x60	# p
+	glyph 0x00,0x00,0x3e,0x66,0x66,0x3e,0x06,0x06	# q
+	glyph 0x00,0x00,0xd8,0xfc,0xe0,0xc0,0xc0,0x00	# r
+	glyph 0x00,0x00,0x3c,0x60,0x38,0x0c,0x78,0x00	# s
+	glyph 0x30,0x30,0x78,0x30,0x30,0x30,0x1c,0x00	# t
+	glyph 0x00,0x00,0x66,0x66,0x66,0x66,0x3e,0x00	# u
+	glyph 0x00,0x00,0xc6,0xc6,0x6c,0x38,0x10,0x00	# v
+	glyph 0x00,0x00,0xc6,0xd6,0xd6,0xd6,0x6c,0x00	# w
+	glyph 0x00,0x00,0xc6,0x6c,0x10,0x6c,0xc6,0x00	# x
+	glyph 0x00,0x00,0x66,0x66,0x66,0x3e,0x06,0x3c	# y
+	glyph 0x00,0x00,0xfe,0x0c,0x38,0x60,0xfe,0x00	# z
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
+	glyph 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00	#
 
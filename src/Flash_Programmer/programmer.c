@@ -16,26 +16,11 @@
 #include <eris/low/7up.h>
 #include <eris/tetsu.h>
 #include <eris/romfont.h>
-#include <eris/bkupmem.h>
-#include <eris/timer.h>
-#include <eris/pad.h>
 
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#include "flash.h"
+#include "telemetry.h"
 
-#define JOY_I            1
-#define JOY_II           2
-#define JOY_III          4
-#define JOY_IV           8
-#define JOY_V            16
-#define JOY_VI           32
-#define JOY_SELECT       64
-#define JOY_RUN          128
-#define JOY_UP           256
-#define JOY_RIGHT        512
-#define JOY_DOWN         1024
-#define JOY_LEFT         2048
-#define JOY_MODE1        4096
-#define JOY_MODE2        16384
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 #define TITLE_LINE       1
 #define INSTRUCT_LINE    3
@@ -44,20 +29,6 @@
 
 #define FXBMP_BASE       0xE8000000      // memory location of start of external backup memory
 
-
-extern void flash_erase_sector( u8 * sector);
-extern void flash_write( u8 * addr, u8 value);
-extern void flash_id( u8 * addr );
-
-void print_at(int x, int y, int pal, char* str);
-void putch_at(int x, int y, int pal, char c);
-void putnumber_at(int x, int y, int pal, int digits, int value);
-
-
-
-extern u8 font[];
-extern u8 fxbmp_mem[];
-
 // These are exported from the "objectization" step of the raw binary file "payload"
 extern u8 binary_payload_start[];
 extern u8 binary_payload_end[];
@@ -67,15 +38,6 @@ extern u8 binary_payload_name_start[];
 extern u8 binary_payload_name_end[];
 
 
-// interrupt-handling variables
-volatile int sda_frame_count = 0;
-volatile int last_sda_frame_count = 0;
-
-/* HuC6270-A's status register (RAM mapping). Used during VSYNC interrupt */
-volatile uint16_t * const MEM_6270A_SR = (uint16_t *) 0x80000400;
-
-
-
 u8   boot_block[4096];  // Initial Flash sector needed for boot
 u8   boot_sequence[] = {
 	0x24, 0x8A, 0xDF,  'P',  'C',  'F',  'X',  'C',  'a',  'r',  'd', 0x80, 0x00, 0x01, 0x01, 0x00,
@@ -96,6 +58,7 @@ u8   chip_id[4];        // first two bytes are buffer for returning flash chip i
 int target_addr = (int) &fxbmp_mem[0];              // 0xe8000000
 int source_addr = (int) &binary_payload_start[0];   // binary_payload_start[]
 int write_len;                                      // size of payload, up to 512KB
+int erase_first_sector;                             // first sector of the range being erased
 
 //char countdown;
 int advance;
@@ -107,47 +70,6 @@ int menu_level;
 int stepval = 0;
 
 
-///////////////////////////////// Joypad routines
-volatile u32 joypad;
-volatile u32 joypad_last;
-volatile u32 joytrg;
-
-__attribute__ ((noinline)) void joyread(void)
-{
-u32 temp;
-
-   joypad_last = joypad;
-   temp = eris_pad_read(0);
-
-   if ((temp >> 28) == PAD_TYPE_FXPAD) {  // PAD TYPE
-      joypad = temp;
-      joytrg = (~joypad_last) & joypad;
-   }
-   else {
-      joypad = 0;
-      joytrg = 0;
-   }
-}
-
-///////////////////////////////// Interrupt handler
-__attribute__ ((interrupt_handler)) void my_vblank_irq (void)
-{
-   uint16_t vdc_status = *MEM_6270A_SR;
-
-   if (vdc_status & 0x20) {
-      sda_frame_count++;
-   }
-   joyread();
-}
-
-void vsync(int numframes)
-{
-   while (sda_frame_count < (last_sda_frame_count + numframes + 1));
-
-   last_sda_frame_count = sda_frame_count;
-}
-
-
 ///////////////////////////////// CODE
 
 //
@@ -160,26 +82,26 @@ __attribute__ ((noinline)) void step(void)
 }
 //////////
 
-void buffer_to_flash(u8 * target)
+// progress of flash_erase_range() and flash_program()
+//
+void erase_progress(int done, int total)
 {
-int i;
+char numeric[8];
 
-   // erase storage slot (8 sectors data + 1 sector comments)
-   //
-   for (i = 0; i < 9; i++)
-   {
-      flash_erase_sector( target + ((i<<1) * 4096));
-   }
+   sprintf(numeric, "%3d", erase_first_sector + (done / FLASH_SECTOR_SIZE));
+   print_at(7, INSTRUCT_LINE+2, 3, "Erasing Sector ");
+   print_at(22, INSTRUCT_LINE+2, 3, numeric);
+   bat_flush();                  // no vsync() until the flash operation is done
+}
 
-   // write the core 32KB data into the storage slot
-   // 
-   for (i = 0; i < 32768; i++)
-   {
-      // add special programming preface
-//      *(target + (i<<1)) = bram_buffer[i];
+void write_progress(int done, int total)
+{
+char numeric[8];
 
-//      flash_write( (target + (i<<1)), bram_buffer[i]);
-   }
+   sprintf(numeric, "%6d", done);
+   print_at(7, INSTRUCT_LINE+2, 3, "Writing Byte ");
+   print_at(20, INSTRUCT_LINE+2, 3, numeric);
+   bat_flush();                  // no vsync() until the flash operation is done
 }
 
 void clear_panel(void)
@@ -199,6 +121,23 @@ void clear_errors(void)
    print_at(5, INSTRUCT_LINE+3, 0, "                                       ");
 }
 
+// leave a failure on screen until it has been seen
+// (top_menu() clears the panel)
+//
+void error_wait(void)
+{
+   input_flush();
+   print_at(7, INSTRUCT_LINE+3, 2, "Press II to continue");
+
+   while (1)
+   {
+      vsync(0);
+
+      if ((joytrg & JOY_RUN) || (joytrg & JOY_II))
+         break;
+   }
+}
+
 void top_menu(void)
 {
 static int menu_selection;
@@ -269,6 +208,9 @@ char tempbuf[16];
       }
 
       vsync(0);
+
+      if (boot_ticks == 0)          // first menu frame is now on screen
+         boot_ticks = ticks_now();
    }
 }
 
@@ -380,6 +322,10 @@ void credits(void)
 
    print_at(11, HEX_LINE+13, 0, "(c) 2023 by David Shadoff");
 
+   print_at(11, HEX_LINE+15, 2, "Startup time:");
+   putnumber_at(25, HEX_LINE+15, 2, 5, boot_ticks / TIMER_TICKS_PER_MS);
+   print_at(31, HEX_LINE+15, 2, "ms");
+
    while (1)
    {
       if ((joytrg & JOY_RUN) || (joytrg & JOY_I))
@@ -391,155 +337,15 @@ void credits(void)
 
 void init(void)
 {
-	int i, j;
-//	u32 str[256];
-	u16 microprog[16];
-	u16 a, img;
-
-	eris_low_sup_init(0);
-	eris_low_sup_init(1);
-	eris_king_init();
-	eris_tetsu_init();
-	
-	eris_tetsu_set_priorities(0, 0, 1, 0, 0, 0, 0);
-	eris_tetsu_set_7up_palette(0, 0);
-	eris_tetsu_set_king_palette(0, 0, 0, 0);
-	eris_tetsu_set_rainbow_palette(0);
-
-	eris_king_set_bg_prio(KING_BGPRIO_3, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, KING_BGPRIO_HIDE, 0);
-	eris_king_set_bg_mode(KING_BGMODE_4_PAL, 0, 0, 0);
-	eris_king_set_kram_pages(0, 0, 0, 0);
-
-	for(i = 0; i < 16; i++) {
-		microprog[i] = KING_CODE_NOP;
-	}
-
-	microprog[0] = KING_CODE_BG0_CG_0;
-	eris_king_disable_microprogram();
-	eris_king_write_microprogram(microprog, 0, 16);
-	eris_king_enable_microprogram();
-
-	//eris_tetsu_set_palette(3, 0x602C);
-	//eris_tetsu_set_palette(4, 0x5080);
-	//eris_tetsu_set_palette(5, 0xC422);
-	//eris_tetsu_set_palette(6, 0x9999);
-	//eris_tetsu_set_palette(7, 0x1234);
-
-	/* Font uses sub-palette #1 for FG, #2 for BG */
-	/* palette #0 is default - light green background, bright white foreground */
-	eris_tetsu_set_palette(0x00, 0x2A66);
-	eris_tetsu_set_palette(0x01, 0xFC88);
-	eris_tetsu_set_palette(0x02, 0x2A66);
-
-	/* palette #1 is selection/inverse - bright white background, light green foreground */
-	eris_tetsu_set_palette(0x10, 0xFC88);
-	eris_tetsu_set_palette(0x11, 0x2A66);
-	eris_tetsu_set_palette(0x12, 0xFC88);
-
-	/* palette #2 is disabled/dimmed - light green background, dimmed white foreground */
-	eris_tetsu_set_palette(0x20, 0x2A66);
-	eris_tetsu_set_palette(0x21, 0x9088);
-	eris_tetsu_set_palette(0x22, 0x2A66);
-
-	/* palette #3 is error/red - light green background, bright red foreground */
-	eris_tetsu_set_palette(0x30, 0x2A66);
-	eris_tetsu_set_palette(0x31, 0x8B3B);  // TODO: get right RED (was 4B5F)
-	eris_tetsu_set_palette(0x32, 0x2A66);
-
-	/* palette #4 is highlight/yellow - light green background, bright yellow foreground */
-	eris_tetsu_set_palette(0x40, 0x2A66);
-	eris_tetsu_set_palette(0x41, 0xDF09);
-	eris_tetsu_set_palette(0x42, 0x2A66);
-
-	/* palette #5 is highlight/blue-green - light green background, blue-green foreground */
-	eris_tetsu_set_palette(0x50, 0x2A66);
-	eris_tetsu_set_palette(0x51, 0x9BB1);
-	eris_tetsu_set_palette(0x52, 0x2A66);
-
-
-	eris_tetsu_set_video_mode(TETSU_LINES_262, 0, TETSU_DOTCLOCK_7MHz, TETSU_COLORS_16,
-				TETSU_COLORS_16, 1, 0, 1, 0, 0, 0, 0);
-	eris_king_set_bat_cg_addr(KING_BG0, 0, 0);
-	eris_king_set_bat_cg_addr(KING_BG0SUB, 0, 0);
-	eris_king_set_scroll(KING_BG0, 0, 0);
-	eris_king_set_bg_size(KING_BG0, KING_BGSIZE_256, KING_BGSIZE_256, KING_BGSIZE_256, KING_BGSIZE_256);
-	eris_low_sup_set_control(0, 0, 1, 0);
-	eris_low_sup_set_access_width(0, 0, SUP_LOW_MAP_64X32, 0, 0);
-	eris_low_sup_set_scroll(0, 0, 0);
-	//eris_low_sup_set_video_mode(0, 2, 2, 4, 0x1F, 0x11, 2, 239, 2); // 5MHz numbers
-	eris_low_sup_set_video_mode(0, 3, 3, 6, 0x2B, 0x11, 2, 239, 2);
-
-	eris_king_set_kram_read(0, 1);
-	eris_king_set_kram_write(0, 1);
-	// Clear BG0's RAM
-	for(i = 0; i < 0x1E00; i++) {
-		eris_king_kram_write(0);
-	}
-	eris_king_set_kram_write(0, 1);
-
-	eris_low_sup_set_vram_write(0, 0);
-	for(i = 0; i < 0x800; i++) {
-		eris_low_sup_vram_write(0, 0x120); // 0x80 is space
-	}
-
-
-	eris_low_sup_set_vram_write(0, 0x1200);
-	// load font into video memory
-	for(i = 0; i < 0x60; i++) {
-		// first 2 planes of color
-		for (j = 0; j < 8; j++) {
-			img = font[(i*8)+j] & 0xff;
-			a = (~img << 8) | img;
-			eris_low_sup_vram_write(0, a);
-		}
-		// last 2 planes of color
-		for (j = 0; j < 8; j++) {
-			eris_low_sup_vram_write(0, 0);
-		}
-	}
-
-	eris_pad_init(0); // initialize joypad
-
-        // Disable all interrupts before changing handlers.
-        irq_set_mask(0x7F);
-
-        // Replace firmware IRQ handlers for the Timer and HuC6270-A.
-        //
-        // This liberis function uses the V810's hardware IRQ numbering,
-        // see FXGA_GA and FXGABOAD documents for more info ...
-        irq_set_raw_handler(0xC, my_vblank_irq);
-
-        // Enable Timer and HuC6270-A interrupts.
-        //
-        // d6=Timer
-        // d5=External
-        // d4=KeyPad
-        // d3=HuC6270-A
-        // d2=HuC6272
-        // d1=HuC6270-B
-        // d0=HuC6273
-        irq_set_mask(0x77);
-
-        // Allow all IRQs.
-        //
-        // This liberis function uses the V810's hardware IRQ numbering,
-        // see FXGA_GA and FXGABOAD documents for more info ...
-        irq_set_level(8);
-
-        // Enable V810 CPU's interrupt handling.
-        irq_enable();
-
-        eris_low_sup_setreg(0, 5, 0x88);  // Set Hu6270 BG to show, and VSYNC Interrupt
-
-        eris_bkupmem_set_access(1,1);  // allow read and write access to both internal and external backup memory
+	console_init(256, 0);     // text only: KING BG0 is not used, and there are no sprites
 }
 
 int main(int argc, char *argv[])
 {
-char numeric[8];
 char hexdata[8];
 int lower_limit;
 int num_sectors;
+int failed;
 int i;
 int name_size;
 
@@ -616,13 +422,16 @@ int name_size;
             print_at(2, INSTRUCT_LINE+2, 0, "                                         ");
 
             /* Erase range */
-            for (i = lower_limit; i < (lower_limit + num_sectors); i++)
-            {
-               sprintf(numeric, "%3d", i);
-               print_at(7, INSTRUCT_LINE+2, 3, "Erasing Sector ");
-               print_at(22, INSTRUCT_LINE+2, 3, numeric);
+            flash_progress = erase_progress;
+            erase_first_sector = lower_limit;
+            failed = flash_erase_range( fxbmp_mem + ((lower_limit * FLASH_SECTOR_SIZE) << 1), num_sectors * FLASH_SECTOR_SIZE );
 
-               flash_erase_sector(  (u8 *) (FXBMP_BASE + ((i<<1) * 4096)) );
+            if (failed)
+            {
+               sprintf(hexdata, "%3d", failed);
+               print_at(7, INSTRUCT_LINE+2, 3, "Erase FAILED:     sectors   ");
+               print_at(21, INSTRUCT_LINE+2, 3, hexdata);
+               error_wait();
             }
          }
 	 else if (menu_A == 5)    // Program Data
@@ -640,81 +449,43 @@ int name_size;
             print_at(2, INSTRUCT_LINE+2, 0, "                                         ");
 
             /* Program Data */
+            flash_progress = write_progress;
+            failed = flash_program( (u8 *) target_addr, binary_payload_start, write_len );
+
+            // read the image back: a byte which timed out, or was not
+            // erased beforehand, is wrong in the cart
             for (i = 0; i < write_len; i++)
             {
-               if ((i & 31) == 0)
-               {
-                  sprintf(numeric, "%6d", i);
-                  print_at(7, INSTRUCT_LINE+2, 3, "Writing Byte ");
-                  print_at(20, INSTRUCT_LINE+2, 3, numeric);
-               }
-
-//               flash_write( (u8 *)(target_addr + (i<<1)), *((u8 *)(source_addr + i)) );
-               flash_write( (u8 *)(target_addr + (i<<1)), binary_payload_start[i] );
+               if (((u8 *) target_addr)[i << 1] != binary_payload_start[i])
+                  break;
+            }
+            if (i < write_len)
+               telemetry_verify_failure();
+
+            // only now: a record written after the erase could land
+            // where the payload is about to be programmed
+            telemetry_flush();
+
+            if (i < write_len)
+            {
+               sprintf(hexdata, "%6.6X", i);
+               print_at(7, INSTRUCT_LINE+2, 3, "Write FAILED at 0x          ");
+               print_at(25, INSTRUCT_LINE+2, 3, hexdata);
+               error_wait();
+            }
+            else if (failed)
+            {
+               print_at(7, INSTRUCT_LINE+2, 3, "Write timed out - check chip");
+               error_wait();
             }
          }
       }
    }
 
    print_at(4, TITLE_LINE, 0, "oops - fatal error");
+   bat_flush();
 
    while(1);
 
    return 0;
 }
-
-// print with first 7up (HuC6270 #0)
-//
-void print_at(int x, int y, int pal, char* str)
-{
-	int i;
-	u16 a;
-
-	i = (y * 64) + x;
-
-	eris_low_sup_set_vram_write(0, i);
-	for (i = 0; i < strlen8(str); i++) {
-		a = (pal * 0x1000) + str[i] + 0x100;
-		eris_low_sup_vram_write(0, a);
-	}
-}
-
-void putch_at(int x, int y, int pal, char c)
-{
-        int i;
-        u16 a;
-
-        i = (y * 64) + x;
-
-        eris_low_sup_set_vram_write(0, i);
-
-        a = (pal * 0x1000) + c + 0x100;
-        eris_low_sup_vram_write(0, a);
-}
-
-void putnumber_at(int x, int y, int pal, int len, int value)
-{
-        int i;
-        u16 a;
-	char str[64];
-
-        i = (y * 64) + x;
-
-	if (len == 2) {
-	   sprintf(str, "%2d", value);
-	}
-	else if (len == 4) {
-	   sprintf(str, "%4d", value);
-	}
-	else if (len == 5) {
-	   sprintf(str, "%5d", value);
-	}
-
-        eris_low_sup_set_vram_write(0, i);
-
-	for (i = 0; i < strlen8(str); i++) {
-                a = (pal * 0x1000) + str[i] + 0x100;
-                eris_low_sup_vram_write(0, a);
-        }
-}
-
@@ -0,0 +1,435 @@
+// (c) 2023 David Shadoff
+//
+// flashsim.cpp - host model of the SST39SF040 flash chip (see flashsim.h)
+//
+// Timings are from the SST39SF010A/020A/040 datasheet.  The bus time is
+// an estimate of one V810 access through the cart's 8-bit stride-2
+// window; it should be replaced with a figure measured on the console.
+//
+#include <cstring>
+#include "flashsim.h"
+
+#define CMD_ADDR1        0x5555          // chip addresses of the unlock cycles
+#define CMD_ADDR2        0x2AAA
+
+#define POLL_LIMIT       1000000         // polls before a host flash function gives up
+
+const struct flashsim_timing flashsim_typical = { 280, 14000, 18000000, 70000000 };
+const struct flashsim_timing flashsim_maximum = { 280, 20000, 25000000, 100000000 };
+
+static const char * const op_name[FLASHSIM_OP_COUNT] = {
+   "read", "program", "sector erase", "chip erase", "id"
+};
+
+// the command state machine: each state is the bus write expected next
+//
+enum state
+{
+   READ_ARRAY,      // AA at 5555 starts a command
+   UNLOCK2,         // 55 at 2AAA
+   COMMAND,         // A0, 80 or 90 at 5555 (or F0 to reset)
+   PROGRAM_DATA,    // data at the target address
+   ERASE_UNLOCK1,   // AA at 5555
+   ERASE_UNLOCK2,   // 55 at 2AAA
+   ERASE_COMMAND,   // 30 at the sector, or 10 at 5555
+   ID_MODE          // ID reads; F0 (or AA/55/F0) to exit
+};
+
+class FlashSim
+{
+public:
+   uint8_t chip[FLASHSIM_SIZE];
+   uint8_t window[FLASHSIM_WINDOW];     // array contents at every second byte
+
+   struct flashsim_timing timing;
+   struct flashsim_stats stats[FLASHSIM_OP_COUNT];
+   struct flashsim_stats pending;       // command cycles not yet known to be part of an operation
+
+   state    st;
+   bool     in_id;                      // unlocking from ID mode, rather than from read
+   int      busy_op;                    // operation in progress (or -1)
+   uint64_t busy_until;
+   uint8_t  busy_data;                  // byte being programmed, for DQ7
+   bool     toggle;                     // DQ6
+   uint64_t now;
+   uint32_t violations;
+   uint32_t timeouts;                   // host flash functions which gave up polling
+
+   void reset(const struct flashsim_timing * t)
+   {
+      memset(chip, 0xFF, sizeof(chip));
+      memset(window, 0xFF, sizeof(window));
+      timing = *t;
+      st = READ_ARRAY;
+      in_id = false;
+      busy_op = -1;
+      busy_until = 0;
+      toggle = false;
+      now = 0;
+      violations = 0;
+      timeouts = 0;
+      clear_stats();
+   }
+
+   void clear_stats(void)
+   {
+      memset(stats, 0, sizeof(stats));
+      memset(&pending, 0, sizeof(pending));
+   }
+
+   void set(uint32_t addr, uint8_t value)
+   {
+      chip[addr] = value;
+      window[addr << 1] = value;
+   }
+
+   // a bus cycle; the operation in progress ends once its time has passed
+   //
+   struct flashsim_stats & cycle(int op)
+   {
+      now += timing.bus_ns;
+
+      if ((busy_op >= 0) && (now >= busy_until))
+      {
+         stats[busy_op].count++;
+         busy_op = -1;
+      }
+
+      struct flashsim_stats & s = (op < 0) ? pending : stats[op];
+      s.sim_ns += timing.bus_ns;
+      return(s);
+   }
+
+   // pending command cycles turn out to belong to operation 'op'
+   //
+   void claim(int op)
+   {
+      stats[op].commands   += pending.commands;
+      stats[op].bus_writes += pending.bus_writes;
+      stats[op].sim_ns     += pending.sim_ns;
+      memset(&pending, 0, sizeof(pending));
+   }
+
+   void start(int op, uint64_t duration)
+   {
+      claim(op);
+      busy_op = op;
+      busy_until = now + duration;
+   }
+
+   uint8_t read(uint32_t offset)
+   {
+      int op = (busy_op >= 0) ? busy_op : ((st == ID_MODE) ? FLASHSIM_OP_ID : FLASHSIM_OP_READ);
+      struct flashsim_stats & s = cycle(op);
+      uint32_t addr = (offset >> 1) & (FLASHSIM_SIZE - 1);
+
+      s.bus_reads++;
+
+      if (offset & 1)                   // A0 is not connected to the chip
+         return(0xFF);
+
+      if (busy_op >= 0)
+      {
+         // status: DQ7 is the complement of the data being programmed
+         // (0 while erasing), and DQ6 toggles on each read
+         toggle = !toggle;
+         if (busy_op == FLASHSIM_OP_PROGRAM)
+            return(((~busy_data) & 0x80) | (toggle ? 0x40 : 0));
+         else
+            return(toggle ? 0x40 : 0);
+      }
+
+      if (st == ID_MODE)
+         return((addr & 1) ? FLASHSIM_DEVICE_ID : FLASHSIM_MFR_ID);
+
+      return(chip[addr]);
+   }
+
+   void write(uint32_t offset, uint8_t data)
+   {
+      uint32_t addr = (offset >> 1) & (FLASHSIM_SIZE - 1);
+
+      if (busy_op >= 0)                 // ignored until the operation completes
+      {
+         cycle(busy_op).bus_writes++;
+         return;
+      }
+
+      struct flashsim_stats & s = cycle(-1);
+      s.bus_writes++;
+      s.commands++;
+
+      if (offset & 1)
+      {
+         st = READ_ARRAY;
+         return;
+      }
+
+      switch (st)
+      {
+         case ID_MODE:
+            if (data == 0xF0)
+            {
+               claim(FLASHSIM_OP_ID);
+               st = READ_ARRAY;
+            }
+            else if ((addr == CMD_ADDR1) && (data == 0xAA))
+            {
+               in_id = true;
+               st = UNLOCK2;
+            }
+            break;
+
+         case READ_ARRAY:
+            in_id = false;
+            st = ((addr == CMD_ADDR1) && (data == 0xAA)) ? UNLOCK2 : READ_ARRAY;
+            break;
+
+         case UNLOCK2:
+            st = ((addr == CMD_ADDR2) && (data == 0x55)) ? COMMAND : READ_ARRAY;
+            break;
+
+         case COMMAND:
+            st = READ_ARRAY;
+            if (addr != CMD_ADDR1)
+               break;
+
+            if (data == 0xA0)
+               st = PROGRAM_DATA;
+            else if (data == 0x80)
+               st = ERASE_UNLOCK1;
+            else if (data == 0x90)
+            {
+               claim(FLASHSIM_OP_ID);
+               stats[FLASHSIM_OP_ID].count++;
+               st = ID_MODE;
+            }
+            else if ((data == 0xF0) && in_id)
+               claim(FLASHSIM_OP_ID);
+            break;
+
+         case PROGRAM_DATA:
+            // programming can only clear bits
+            if ((chip[addr] & data) != data)
+               violations++;
+
+            set(addr, chip[addr] & data);
+            busy_data = data;
+            start(FLASHSIM_OP_PROGRAM, timing.program_ns);
+            stats[FLASHSIM_OP_PROGRAM].bytes++;
+            st = READ_ARRAY;
+            break;
+
+         case ERASE_UNLOCK1:
+            st = ((addr == CMD_ADDR1) && (data == 0xAA)) ? ERASE_UNLOCK2 : READ_ARRAY;
+            break;
+
+         case ERASE_UNLOCK2:
+            st = ((addr == CMD_ADDR2) && (data == 0x55)) ? ERASE_COMMAND : READ_ARRAY;
+            break;
+
+         case ERASE_COMMAND:
+            st = READ_ARRAY;
+            if (data == 0x30)
+            {
+               uint32_t sector = addr & ~(FLASHSIM_SECTOR - 1);
+
+               for (uint32_t i = 0; i < FLASHSIM_SECTOR; i++)
+                  set(sector + i, 0xFF);
+
+               start(FLASHSIM_OP_SECTOR_ERASE, timing.sector_erase_ns);
+               stats[FLASHSIM_OP_SECTOR_ERASE].bytes++;
+            }
+            else if ((data == 0x10) && (addr == CMD_ADDR1))
+            {
+               memset(chip, 0xFF, sizeof(chip));
+               memset(window, 0xFF, sizeof(window));
+
+               start(FLASHSIM_OP_CHIP_ERASE, timing.chip_erase_ns);
+               stats[FLASHSIM_OP_CHIP_ERASE].bytes += FLASHSIM_SIZE / FLASHSIM_SECTOR;
+            }
+            break;
+      }
+   }
+};
+
+static FlashSim sim;
+
+
+extern "C" {
+
+void flashsim_reset(const struct flashsim_timing * timing)
+{
+   sim.reset(timing ? timing : &flashsim_typical);
+}
+
+uint8_t * flashsim_window(void)
+{
+   return(sim.window);
+}
+
+uint8_t * flashsim_chip(void)
+{
+   return(sim.chip);
+}
+
+int flashsim_load(const char * filename)
+{
+FILE * f;
+size_t n;
+
+   f = fopen(filename, "rb");
+   if (f == NULL)
+      return(-1);
+
+   n = fread(sim.chip, 1, FLASHSIM_SIZE, f);
+   fclose(f);
+
+   // a shorter image leaves the rest of the chip erased
+   for (uint32_t i = 0; i < FLASHSIM_SIZE; i++)
+      sim.set(i, (i < n) ? sim.chip[i] : 0xFF);
+
+   return(0);
+}
+
+int flashsim_save(const char * filename)
+{
+FILE * f;
+size_t n;
+
+   f = fopen(filename, "wb");
+   if (f == NULL)
+      return(-1);
+
+   n = fwrite(sim.chip, 1, FLASHSIM_SIZE, f);
+   fclose(f);
+
+   return((n == FLASHSIM_SIZE) ? 0 : -1);
+}
+
+uint8_t flashsim_bus_read(uint32_t offset)
+{
+   return(sim.read(offset));
+}
+
+void flashsim_bus_write(uint32_t offset, uint8_t data)
+{
+   sim.write(offset, data);
+}
+
+uint32_t flashsim_window_offset(const volatile uint8_t * addr)
+{
+   return((uint32_t)(addr - sim.window) & (FLASHSIM_WINDOW - 1));
+}
+
+uint64_t flashsim_time_ns(void)
+{
+   return(sim.now);
+}
+
+void flashsim_set_time(uint64_t ns)
+{
+   if (ns > sim.now)
+      sim.now = ns;
+}
+
+uint32_t flashsim_violations(void)
+{
+   return(sim.violations);
+}
+
+uint32_t flashsim_timeouts(void)
+{
+   return(sim.timeouts);
+}
+
+const struct flashsim_stats * flashsim_stats(enum flashsim_op op)
+{
+   return(&sim.stats[op]);
+}
+
+void flashsim_clear_stats(void)
+{
+   sim.clear_stats();
+}
+
+void flashsim_report(FILE * out)
+{
+   fprintf(out, "%-13s %8s %9s %10s %10s %8s %12s\n",
+           "operation", "count", "commands", "bus reads", "bus writes", "bytes", "sim ms");
+
+   for (int op = 0; op < FLASHSIM_OP_COUNT; op++)
+   {
+      const struct flashsim_stats & s = sim.stats[op];
+
+      fprintf(out, "%-13s %8u %9u %10u %10u %8u %12.3f\n", op_name[op],
+              s.count, s.commands, s.bus_reads, s.bus_writes, s.bytes, s.sim_ns / 1000000.0);
+   }
+
+   fprintf(out, "simulated time: %.3f ms", sim.now / 1000000.0);
+   if (sim.violations)
+      fprintf(out, ", %u programs tried to set bits (1->0 only)", sim.violations);
+   if (sim.timeouts)
+      fprintf(out, ", %u operations timed out", sim.timeouts);
+   fprintf(out, "\n");
+}
+
+
+// flashfuncs.s, as bus cycles
+//
+#define UNLOCK(cmd)  do { flashsim_bus_write(CMD_ADDR1 * 2, 0xAA);  \
+                          flashsim_bus_write(CMD_ADDR2 * 2, 0x55);  \
+                          flashsim_bus_write(CMD_ADDR1 * 2, cmd); } while (0)
+
+int flash_erase_sector(uint8_t * addr)
+{
+uint32_t offset = flashsim_window_offset(addr);
+int polls = 0;
+
+   UNLOCK(0x80);
+   flashsim_bus_write(CMD_ADDR1 * 2, 0xAA);
+   flashsim_bus_write(CMD_ADDR2 * 2, 0x55);
+   flashsim_bus_write(offset, 0x30);
+
+   while ((flashsim_bus_read(offset) != 0xFF) && (++polls < POLL_LIMIT));
+
+   if (polls == POLL_LIMIT)
+   {
+      sim.timeouts++;
+      return(-1);
+   }
+
+   return(0);
+}
+
+int flash_write(uint8_t * addr, uint8_t data)
+{
+uint32_t offset = flashsim_window_offset(addr);
+int polls = 0;
+
+   UNLOCK(0xA0);
+   flashsim_bus_write(offset, data);
+
+   // flashfuncs.s gives up the same way, if a bit cannot be programmed
+   while ((flashsim_bus_read(offset) != data) && (++polls < POLL_LIMIT));
+
+   if (polls == POLL_LIMIT)
+   {
+      sim.timeouts++;
+      return(-1);
+   }
+
+   return(0);
+}
+
+void flash_id(uint8_t * ptr)
+{
+   UNLOCK(0x90);
+
+   ptr[0] = flashsim_bus_read(0);
+   ptr[1] = flashsim_bus_read(2);
+
+   UNLOCK(0xF0);
+}
+
+}
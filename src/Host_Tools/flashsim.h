@@ -0,0 +1,91 @@
+/*
+ * flashsim.h - host model of the SST39SF040 flash chip in an FX-Flash cart
+ *
+ * The chip is seen the way the PC-FX sees it: through a 1MB window in
+ * which the chip's bytes are at every second address (offset = chip
+ * address * 2), like fxbmp_mem at 0xE8000000.  Bus reads and writes go
+ * through the chip's command state machine, with 1->0-only programming,
+ * DQ7/DQ6 status while busy, and datasheet timing on a simulated clock.
+ *
+ * flash_erase_sector(), flash_write() and flash_id() here take the same
+ * arguments as those in flashfuncs.s, and issue the same bus cycles, so
+ * storage code can be built and run on the host against the model.
+ */
+#ifndef FLASHSIM_H
+#define FLASHSIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASHSIM_SIZE        (512 * 1024)             /* SST39SF040 */
+#define FLASHSIM_WINDOW      (FLASHSIM_SIZE * 2)      /* stride-2 bus window */
+#define FLASHSIM_SECTOR      4096
+
+#define FLASHSIM_MFR_ID      0xBF
+#define FLASHSIM_DEVICE_ID   0xB7
+
+/* operations which are counted separately in the report */
+enum flashsim_op
+{
+   FLASHSIM_OP_READ = 0,      /* array reads outside of any command */
+   FLASHSIM_OP_PROGRAM,
+   FLASHSIM_OP_SECTOR_ERASE,
+   FLASHSIM_OP_CHIP_ERASE,
+   FLASHSIM_OP_ID,
+   FLASHSIM_OP_COUNT
+};
+
+struct flashsim_stats
+{
+   uint32_t count;            /* operations completed */
+   uint32_t commands;         /* command (unlock/setup) bus writes */
+   uint32_t bus_reads;        /* including status polling */
+   uint32_t bus_writes;
+   uint32_t bytes;            /* bytes programmed, or sectors erased */
+   uint64_t sim_ns;           /* simulated time, bus cycles plus busy time */
+};
+
+struct flashsim_timing
+{
+   uint32_t bus_ns;           /* one access through the stride-2 window */
+   uint32_t program_ns;       /* TBP */
+   uint32_t sector_erase_ns;  /* TSE */
+   uint32_t chip_erase_ns;    /* TSCE */
+};
+
+/* datasheet typical and maximum timings */
+extern const struct flashsim_timing flashsim_typical;
+extern const struct flashsim_timing flashsim_maximum;
+
+void     flashsim_reset(const struct flashsim_timing * timing);
+uint8_t * flashsim_window(void);       /* 1MB stride-2 view of the array (read only) */
+uint8_t * flashsim_chip(void);         /* the 512KB array itself */
+int      flashsim_load(const char * filename);
+int      flashsim_save(const char * filename);
+
+uint8_t  flashsim_bus_read(uint32_t offset);
+void     flashsim_bus_write(uint32_t offset, uint8_t data);
+uint32_t flashsim_window_offset(const volatile uint8_t * addr);
+
+uint64_t flashsim_time_ns(void);
+void     flashsim_set_time(uint64_t ns);   /* catch the clock up with a caller's own (never moves it back) */
+uint32_t flashsim_violations(void);    /* programs which tried to turn a 0 bit into 1 */
+uint32_t flashsim_timeouts(void);      /* flash_write()/flash_erase_sector() which never completed */
+const struct flashsim_stats * flashsim_stats(enum flashsim_op op);
+void     flashsim_clear_stats(void);
+void     flashsim_report(FILE * out);
+
+/* as in flashfuncs.s - 'addr' is within flashsim_window(); 0, or -1 on a timeout */
+int      flash_erase_sector(uint8_t * addr);
+int      flash_write(uint8_t * addr, uint8_t data);
+void     flash_id(uint8_t * ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
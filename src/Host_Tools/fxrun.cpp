@@ -0,0 +1,1077 @@
+// (c) 2023 David Shadoff
+//
+// fxrun - run a linked PC-FX program (bank.linked, programmer.linked)
+// headless on the development machine, driven by a script
+//
+// The program runs on the V810 interpreter (v810.cpp), with 2MB of RAM,
+// internal backup memory at 0xE0000000 and the FX-BMP cart at 0xE8000000
+// - the flash chip model (flashsim.cpp), with its timings on the same
+// clock as the CPU.  The first HuC6270 (7up) is modelled far enough for
+// its VRAM, the VSYNC and raster interrupts to work, and the timer for
+// its interrupt and counter.
+//
+// liberis is replaced at the level of its functions (eris_pad_read()
+// returns what the script holds down, for example); most of them only
+// set up video hardware, and do nothing here.  The ROM font is not
+// available, so printsjis() text is taken from its arguments instead.
+//
+// The script presses keys, waits for text to appear on the screen,
+// checks it, and measures the CPU cycles, frames and flash operations
+// of whole user operations - see usage().
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include "v810.h"
+#include "flashsim.h"
+
+#define CPU_HZ           21477270
+#define CYCLES_PER_LINE  1365
+#define LINES_PER_FRAME  263
+#define VBLANK_LINE      240             // VSYNC, after the last displayed line
+#define RCR_FIRST_LINE   64              // the raster compare value of line 0
+#define TIMER_DIVIDER    15              // the timer counts at the CPU clock / 15
+#define STUB_CYCLES      20              // for a call to a replaced liberis function
+
+#define RAM_SIZE         0x200000
+#define BRAM_BASE        0xE0000000
+#define BRAM_WINDOW      0x10000         // 32KB at every second byte
+#define FLASH_BASE       0xE8000000
+#define IO_BASE          0x80000000      // I/O ports, also seen in memory here
+#define IO_WINDOW        0x01000000
+
+#define VDC_PORT_AR      0x400           // HuC6270 #0: register select / status
+#define VDC_PORT_DATA    0x404
+#define VDC_VRAM_WORDS   0x10000
+#define VDC_REG_MAWR     0
+#define VDC_REG_MARR     1
+#define VDC_REG_VWR      2
+#define VDC_REG_CR       5
+#define VDC_REG_RCR      6
+#define VDC_CR_RR_IRQ    0x0004
+#define VDC_CR_VD_IRQ    0x0008
+#define VDC_STATUS_RR    0x04
+#define VDC_STATUS_VD    0x20
+
+#define IRQ_VDC0         12              // V810 interrupt levels
+#define IRQ_TIMER        9
+
+#define BAT_WIDTH        64              // as set up by both programs
+#define BAT_HEIGHT       64
+#define BAT_FONT_BASE    0x100           // cell of character 0, palette 0
+#define KING_ROWS        32
+
+#define PAD_TYPE_FXPAD   0xF0000000
+#define PRESS_FRAMES     2               // a press is held, then released, for this long
+#define WAIT_FRAMES      600             // default limit for 'wait_for'
+#define DEFAULT_FRAMES   300             // run for this long without a script
+
+#define ELF_PT_LOAD      1
+#define ELF_SHT_SYMTAB   2
+#define ELF_STT_NOTYPE   0
+#define ELF_STT_FUNC     2
+
+static uint32_t le16(const uint8_t * p) { return(p[0] | (p[1] << 8)); }
+static uint32_t le32(const uint8_t * p) { return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24)); }
+
+
+// replaced liberis functions
+//
+enum stub_id
+{
+   STUB_NOP,
+   STUB_PAD_READ,
+   STUB_TIMER_SET_PERIOD,
+   STUB_TIMER_START,
+   STUB_TIMER_STOP,
+   STUB_TIMER_READ,
+   STUB_TIMER_ACK,
+   STUB_IRQ_HANDLER,
+   STUB_IRQ_MASK,
+   STUB_IRQ_LEVEL,
+   STUB_IRQ_ENABLE,
+   STUB_IRQ_DISABLE,
+   STUB_SUP_SETREG,
+   STUB_SUP_SET_VRAM_WRITE,
+   STUB_SUP_VRAM_WRITE,
+   STUB_SUP_SET_VRAM_READ,
+   STUB_SUP_VRAM_READ,
+   STUB_ROMFONT_GET,
+   WATCH_PRINTSJIS                 // not replaced; its text is recorded
+};
+
+static const struct { const char * name; stub_id id; } stub_names[] = {
+   { "eris_pad_read",                STUB_PAD_READ },
+   { "eris_timer_set_period",        STUB_TIMER_SET_PERIOD },
+   { "eris_timer_start",             STUB_TIMER_START },
+   { "eris_timer_stop",              STUB_TIMER_STOP },
+   { "eris_timer_read_counter",      STUB_TIMER_READ },
+   { "eris_timer_ack_irq",           STUB_TIMER_ACK },
+   { "irq_set_raw_handler",          STUB_IRQ_HANDLER },
+   { "irq_set_mask",                 STUB_IRQ_MASK },
+   { "irq_set_level",                STUB_IRQ_LEVEL },
+   { "irq_enable",                   STUB_IRQ_ENABLE },
+   { "irq_disable",                  STUB_IRQ_DISABLE },
+   { "eris_low_sup_setreg",          STUB_SUP_SETREG },
+   { "eris_low_sup_set_vram_write",  STUB_SUP_SET_VRAM_WRITE },
+   { "eris_low_sup_vram_write",      STUB_SUP_VRAM_WRITE },
+   { "eris_low_sup_set_vram_read",   STUB_SUP_SET_VRAM_READ },
+   { "eris_low_sup_vram_read",       STUB_SUP_VRAM_READ },
+   { "eris_romfont_get",             STUB_ROMFONT_GET },
+   { "printsjis",                    WATCH_PRINTSJIS },
+};
+
+static const struct { const char * name; uint32_t bit; } pad_keys[] = {
+   { "I",      0x0001 }, { "II",    0x0002 }, { "III",   0x0004 },
+   { "IV",     0x0008 }, { "V",     0x0010 }, { "VI",    0x0020 },
+   { "SELECT", 0x0040 }, { "RUN",   0x0080 }, { "UP",    0x0100 },
+   { "RIGHT",  0x0200 }, { "DOWN",  0x0400 }, { "LEFT",  0x0800 },
+};
+
+// flash activity, for measuring an operation
+//
+struct flash_totals
+{
+   uint32_t bus_reads;
+   uint32_t programmed;
+   uint32_t erased;
+   uint64_t sim_ns;
+};
+
+struct measurement
+{
+   uint64_t     cycles;
+   uint64_t     frame;
+   flash_totals flash;
+};
+
+
+class Machine : public V810Bus
+{
+public:
+   V810 cpu;
+
+   std::vector<uint8_t> ram;
+   uint8_t  bram[BRAM_WINDOW];
+   std::map<std::string, uint32_t> symbols;
+   std::map<uint32_t, stub_id> stubs;
+   std::vector<uint8_t> hooked;        // by halfword of RAM
+
+   // HuC6270 #0
+   uint16_t vram[VDC_VRAM_WORDS];
+   uint16_t vdc_reg[32];
+   int      vdc_ar;
+   uint16_t vdc_mawr, vdc_marr;
+   uint8_t  vdc_status;
+   uint8_t  vdc_data_lo;
+
+   // timer
+   bool     timer_running;
+   bool     timer_irq;
+   bool     timer_pending;
+   uint32_t timer_period;
+   uint64_t timer_start;
+   uint64_t timer_next;
+
+   uint32_t irq_mask;
+   uint32_t irq_handler[16];
+
+   uint32_t pad;
+   int      line;
+   uint64_t next_line;
+   uint64_t frame;
+   uint32_t unmapped;
+
+   std::vector<std::string> king_text;  // printsjis() text, by row
+
+   Machine() : cpu(*this), ram(RAM_SIZE, 0), hooked(RAM_SIZE / 2, 0), king_text(KING_ROWS)
+   {
+      memset(bram, 0, sizeof(bram));
+      memset(vram, 0, sizeof(vram));
+      memset(vdc_reg, 0, sizeof(vdc_reg));
+      vdc_ar = 0;
+      vdc_mawr = vdc_marr = 0;
+      vdc_status = 0;
+      vdc_data_lo = 0;
+
+      timer_running = timer_irq = timer_pending = false;
+      timer_period = 0xFFFF;
+      timer_start = timer_next = 0;
+
+      irq_mask = 0x7F;
+      memset(irq_handler, 0, sizeof(irq_handler));
+
+      pad = 0;
+      line = 0;
+      next_line = CYCLES_PER_LINE;
+      frame = 0;
+      unmapped = 0;
+   }
+
+   uint64_t now_ns(void)
+   {
+      return((cpu.cycles / CPU_HZ) * 1000000000ULL + ((cpu.cycles % CPU_HZ) * 1000000000ULL) / CPU_HZ);
+   }
+
+   // -------- program loading
+
+   bool load_elf(const char * filename)
+   {
+      FILE * f = fopen(filename, "rb");
+      std::vector<uint8_t> elf;
+      long size;
+
+      if (f == NULL)
+      {
+         printf("Error: cannot open %s\n", filename);
+         return(false);
+      }
+
+      fseek(f, 0, SEEK_END);
+      size = ftell(f);
+      fseek(f, 0, SEEK_SET);
+      elf.resize(size);
+      if ((size < 52) || (fread(elf.data(), 1, size, f) != (size_t) size))
+         size = 0;
+      fclose(f);
+
+      if ((size == 0) || (memcmp(elf.data(), "\177ELF\001\001", 6) != 0))
+      {
+         printf("Error: %s is not a 32-bit little-endian ELF file (use the .linked file)\n", filename);
+         return(false);
+      }
+
+      uint32_t phoff = le32(&elf[28]), shoff = le32(&elf[32]);
+      uint32_t phentsize = le16(&elf[42]), phnum = le16(&elf[44]);
+      uint32_t shentsize = le16(&elf[46]), shnum = le16(&elf[48]);
+
+      for (uint32_t i = 0; i < phnum; i++)
+      {
+         const uint8_t * ph = &elf[phoff + (i * phentsize)];
+         uint32_t vaddr = le32(ph + 8), offset = le32(ph + 4);
+         uint32_t filesz = le32(ph + 16), memsz = le32(ph + 20);
+
+         if ((le32(ph) != ELF_PT_LOAD) || (memsz == 0))
+            continue;
+
+         if ((vaddr >= RAM_SIZE) || (memsz > RAM_SIZE - vaddr) || (offset + filesz > (uint32_t) size))
+         {
+            printf("Error: segment at %08X (%u bytes) is not within RAM\n", vaddr, memsz);
+            return(false);
+         }
+
+         memcpy(&ram[vaddr], &elf[offset], filesz);
+         memset(&ram[vaddr + filesz], 0, memsz - filesz);
+      }
+
+      for (uint32_t i = 0; i < shnum; i++)
+      {
+         const uint8_t * sh = &elf[shoff + (i * shentsize)];
+
+         if (le32(sh + 4) != ELF_SHT_SYMTAB)
+            continue;
+
+         const uint8_t * strtab = &elf[le32(&elf[shoff + (le32(sh + 24) * shentsize) + 16])];
+         uint32_t count = le32(sh + 20) / 16;
+
+         for (uint32_t j = 0; j < count; j++)
+         {
+            const uint8_t * sym = &elf[le32(sh + 16) + (j * 16)];
+            int type = sym[12] & 0xF;
+
+            if ((type == ELF_STT_NOTYPE) || (type == ELF_STT_FUNC))
+               symbols[(const char *) strtab + le32(sym)] = le32(sym + 4);
+         }
+      }
+
+      cpu.reset(le32(&elf[24]));
+      return(true);
+   }
+
+   // v810-gcc puts '_' in front of C names
+   //
+   bool find_symbol(const char * name, uint32_t * addr)
+   {
+      std::map<std::string, uint32_t>::iterator it = symbols.find(std::string("_") + name);
+
+      if (it == symbols.end())
+         it = symbols.find(name);
+      if ((it == symbols.end()) || (it->second >= RAM_SIZE))
+         return(false);
+
+      *addr = it->second;
+      return(true);
+   }
+
+   void hook(uint32_t addr, stub_id id)
+   {
+      stubs[addr] = id;
+      hooked[addr >> 1] = 1;
+   }
+
+   int install_stubs(void)
+   {
+      uint32_t addr;
+      int count = 0;
+
+      // every other liberis function only sets up hardware which is not modelled
+      for (std::map<std::string, uint32_t>::iterator it = symbols.begin(); it != symbols.end(); ++it)
+      {
+         if ((it->first.compare(0, 6, "_eris_") == 0) && (it->second < RAM_SIZE))
+         {
+            hook(it->second, STUB_NOP);
+            count++;
+         }
+      }
+
+      for (size_t i = 0; i < sizeof(stub_names) / sizeof(stub_names[0]); i++)
+      {
+         if (find_symbol(stub_names[i].name, &addr))
+            hook(addr, stub_names[i].id);
+      }
+
+      return(count);
+   }
+
+   // -------- replaced functions
+
+   void sup_write_vram(uint16_t value)
+   {
+      static const int step[4] = { 1, 32, 64, 128 };
+
+      vram[vdc_mawr] = value;
+      vdc_mawr += step[(vdc_reg[VDC_REG_CR] >> 11) & 3];
+   }
+
+   uint16_t sup_read_vram(void)
+   {
+      static const int step[4] = { 1, 32, 64, 128 };
+      uint16_t value = vram[vdc_marr];
+
+      vdc_marr += step[(vdc_reg[VDC_REG_CR] >> 11) & 3];
+      return(value);
+   }
+
+   void sup_setreg(int reg, uint16_t value)
+   {
+      vdc_reg[reg & 31] = value;
+
+      if (reg == VDC_REG_MAWR)
+         vdc_mawr = value;
+      else if (reg == VDC_REG_MARR)
+         vdc_marr = value;
+      else if (reg == VDC_REG_VWR)
+         sup_write_vram(value);
+   }
+
+   uint16_t timer_counter(void)
+   {
+      if (!timer_running || (timer_period == 0))
+         return(timer_period);
+
+      return(timer_period - (((cpu.cycles - timer_start) / TIMER_DIVIDER) % timer_period));
+   }
+
+   std::string read_string(uint32_t addr)
+   {
+      std::string s;
+
+      while ((addr < RAM_SIZE) && (ram[addr] != 0))
+         s += (char) ram[addr++];
+
+      return(s);
+   }
+
+   void record_printsjis(uint32_t text, int x, int y)
+   {
+      std::string s = read_string(text);
+      std::string & row = king_text[(y >> 3) & (KING_ROWS - 1)];
+
+      // two-byte characters are shown as '#'
+      for (size_t i = 0; i < s.size(); i++)
+      {
+         if (((uint8_t) s[i] >= 0x81) && (((uint8_t) s[i] < 0xA1) || ((uint8_t) s[i] > 0xDF)))
+            s[i] = '#';
+      }
+
+      if (row.size() < x + s.size())
+         row.resize(x + s.size(), ' ');
+      row.replace(x, s.size(), s);
+   }
+
+   void call_stub(stub_id id)
+   {
+      uint32_t * a = &cpu.r[6];
+      uint32_t result = 0;
+
+      if (id == WATCH_PRINTSJIS)
+      {
+         record_printsjis(a[0], a[1], a[2]);
+         return;
+      }
+
+      switch (id)
+      {
+         case STUB_PAD_READ:
+            result = (a[0] == 0) ? (PAD_TYPE_FXPAD | pad) : 0;
+            break;
+
+         case STUB_TIMER_SET_PERIOD:
+            timer_period = a[0] & 0xFFFF;
+            break;
+
+         case STUB_TIMER_START:
+            timer_running = true;
+            timer_irq = (a[0] != 0);
+            timer_start = cpu.cycles;
+            timer_next = cpu.cycles + ((uint64_t) timer_period * TIMER_DIVIDER);
+            break;
+
+         case STUB_TIMER_STOP:
+            timer_running = false;
+            break;
+
+         case STUB_TIMER_READ:
+            result = timer_counter();
+            break;
+
+         case STUB_TIMER_ACK:
+            timer_pending = false;
+            break;
+
+         case STUB_IRQ_HANDLER:
+            irq_handler[a[0] & 15] = a[1];
+            break;
+
+         case STUB_IRQ_MASK:
+            irq_mask = a[0];
+            break;
+
+         case STUB_IRQ_LEVEL:
+            cpu.sr[V810_PSW] = (cpu.sr[V810_PSW] & ~PSW_I_MASK) | ((a[0] & 15) << PSW_I_SHIFT);
+            break;
+
+         case STUB_IRQ_ENABLE:
+            cpu.sr[V810_PSW] &= ~PSW_ID;
+            break;
+
+         case STUB_IRQ_DISABLE:
+            cpu.sr[V810_PSW] |= PSW_ID;
+            break;
+
+         case STUB_SUP_SETREG:
+            if (a[0] == 0)
+               sup_setreg(a[1], a[2]);
+            break;
+
+         case STUB_SUP_SET_VRAM_WRITE:
+            if (a[0] == 0)
+            {
+               vdc_mawr = a[1];
+               vdc_ar = VDC_REG_VWR;
+            }
+            break;
+
+         case STUB_SUP_VRAM_WRITE:
+            if (a[0] == 0)
+               sup_write_vram(a[1]);
+            break;
+
+         case STUB_SUP_SET_VRAM_READ:
+            if (a[0] == 0)
+            {
+               vdc_marr = a[1];
+               vdc_ar = VDC_REG_VWR;
+            }
+            break;
+
+         case STUB_SUP_VRAM_READ:
+            result = (a[0] == 0) ? sup_read_vram() : 0;
+            break;
+
+         case STUB_ROMFONT_GET:
+            result = 0;          // no ROM font: a blank glyph from the bottom of RAM
+            break;
+
+         default:
+            break;
+      }
+
+      cpu.r[10] = result;
+      cpu.pc = cpu.r[31];
+      cpu.cycles += STUB_CYCLES;
+      update_irq();
+   }
+
+   // -------- interrupts and video timing
+
+   void update_irq(void)
+   {
+      int level = -1;
+
+      if (vdc_status && !(irq_mask & (1 << (15 - IRQ_VDC0))))
+         level = IRQ_VDC0;
+      else if (timer_pending && !(irq_mask & (1 << (15 - IRQ_TIMER))))
+         level = IRQ_TIMER;
+
+      cpu.irq_level = level;
+   }
+
+   void next_scanline(void)
+   {
+      next_line += CYCLES_PER_LINE;
+
+      if (++line == LINES_PER_FRAME)
+         line = 0;
+
+      if ((vdc_reg[VDC_REG_CR] & VDC_CR_RR_IRQ) &&
+          (line == (int)(vdc_reg[VDC_REG_RCR] & 0x3FF) - RCR_FIRST_LINE))
+         vdc_status |= VDC_STATUS_RR;
+
+      if (line == VBLANK_LINE)
+      {
+         frame++;
+         if (vdc_reg[VDC_REG_CR] & VDC_CR_VD_IRQ)
+            vdc_status |= VDC_STATUS_VD;
+      }
+
+      update_irq();
+   }
+
+   void run_to_frame(uint64_t target)
+   {
+      while ((frame < target) && !cpu.stopped)
+      {
+         if ((cpu.pc < RAM_SIZE) && hooked[cpu.pc >> 1] && !cpu.halted)
+         {
+            stub_id id = stubs[cpu.pc];
+
+            call_stub(id);
+            if (id != WATCH_PRINTSJIS)
+               continue;
+         }
+
+         cpu.step();
+
+         while (cpu.cycles >= next_line)
+            next_scanline();
+
+         if (timer_running && (cpu.cycles >= timer_next))
+         {
+            timer_next += (uint64_t) timer_period * TIMER_DIVIDER;
+            if (timer_irq)
+            {
+               timer_pending = true;
+               update_irq();
+            }
+         }
+      }
+   }
+
+   // -------- the bus
+
+   void warn_unmapped(const char * what, uint32_t addr)
+   {
+      if (unmapped++ < 10)
+         printf("warning: %s of unmapped address %08X (pc %08X)\n", what, addr, cpu.pc);
+   }
+
+   uint8_t read8(uint32_t addr)
+   {
+      if (addr < RAM_SIZE)
+         return(ram[addr]);
+
+      if ((addr - BRAM_BASE) < BRAM_WINDOW)
+         return(bram[addr - BRAM_BASE]);
+
+      if ((addr - FLASH_BASE) < FLASHSIM_WINDOW)
+      {
+         uint64_t start = now_ns();
+         uint8_t value;
+
+         flashsim_set_time(start);
+         value = flashsim_bus_read(addr - FLASH_BASE);
+         cpu.cycles += (((flashsim_time_ns() - start) * CPU_HZ) + 999999999ULL) / 1000000000ULL;
+         return(value);
+      }
+
+      if ((addr - IO_BASE) < IO_WINDOW)
+         return(in(addr - IO_BASE, 1));
+
+      warn_unmapped("read", addr);
+      return(0);
+   }
+
+   void write8(uint32_t addr, uint8_t value)
+   {
+      if (addr < RAM_SIZE)
+         ram[addr] = value;
+      else if ((addr - BRAM_BASE) < BRAM_WINDOW)
+      {
+         if (!(addr & 1))          // only every second byte is there
+            bram[addr - BRAM_BASE] = value;
+      }
+      else if ((addr - FLASH_BASE) < FLASHSIM_WINDOW)
+      {
+         uint64_t start = now_ns();
+
+         flashsim_set_time(start);
+         flashsim_bus_write(addr - FLASH_BASE, value);
+         cpu.cycles += (((flashsim_time_ns() - start) * CPU_HZ) + 999999999ULL) / 1000000000ULL;
+      }
+      else if ((addr - IO_BASE) < IO_WINDOW)
+         out(addr - IO_BASE, value, 1);
+      else
+         warn_unmapped("write", addr);
+   }
+
+   uint32_t read(uint32_t addr, int size)
+   {
+      if ((addr < RAM_SIZE) && (size == 2))
+         return(le16(&ram[addr]));
+      if ((addr < RAM_SIZE) && (size == 4))
+         return(le32(&ram[addr]));
+
+      if (((addr - IO_BASE) < IO_WINDOW) && (size > 1))
+         return(in(addr - IO_BASE, size));
+
+      uint32_t value = 0;
+      for (int i = 0; i < size; i++)
+         value |= read8(addr + i) << (i * 8);
+
+      return(value);
+   }
+
+   void write(uint32_t addr, uint32_t value, int size)
+   {
+      if (((addr - IO_BASE) < IO_WINDOW) && (size > 1))
+      {
+         out(addr - IO_BASE, value, size);
+         return;
+      }
+
+      for (int i = 0; i < size; i++)
+         write8(addr + i, value >> (i * 8));
+   }
+
+   uint32_t in(uint32_t port, int size)
+   {
+      uint32_t value = 0;
+
+      if (port == VDC_PORT_AR)
+      {
+         value = vdc_status;          // reading the status acknowledges the interrupt
+         vdc_status = 0;
+         update_irq();
+      }
+      else if ((port == VDC_PORT_DATA) && (vdc_ar == VDC_REG_VWR))
+         value = sup_read_vram();
+
+      return(value);
+   }
+
+   void out(uint32_t port, uint32_t value, int size)
+   {
+      if (port == VDC_PORT_AR)
+         vdc_ar = value & 31;
+      else if ((port == VDC_PORT_DATA) && (size == 1))
+         vdc_data_lo = value;
+      else if (port == VDC_PORT_DATA)
+         sup_setreg(vdc_ar, value);
+      else if (port == VDC_PORT_DATA + 2)
+         sup_setreg(vdc_ar, vdc_data_lo | ((value & 0xFF) << 8));
+   }
+
+   uint32_t irq_vector(int level)
+   {
+      return(irq_handler[level & 15]);
+   }
+
+   bool trap(int vector)
+   {
+      snprintf(cpu.fault, sizeof(cpu.fault), "program ended (TRAP %d)", vector);
+      return(false);
+   }
+
+   // -------- what is on the screen
+
+   std::string bat_row(int y)
+   {
+      std::string s(BAT_WIDTH, ' ');
+
+      for (int x = 0; x < BAT_WIDTH; x++)
+      {
+         int ch = (vram[(y * BAT_WIDTH) + x] & 0x0FFF) - BAT_FONT_BASE;
+
+         if ((ch > ' ') && (ch < 0x7F))
+            s[x] = ch;
+      }
+
+      return(s.substr(0, s.find_last_not_of(' ') + 1));
+   }
+
+   bool on_screen(const std::string & text)
+   {
+      for (int y = 0; y < BAT_HEIGHT; y++)
+      {
+         if (bat_row(y).find(text) != std::string::npos)
+            return(true);
+      }
+
+      for (int y = 0; y < KING_ROWS; y++)
+      {
+         if (king_text[y].find(text) != std::string::npos)
+            return(true);
+      }
+
+      return(false);
+   }
+
+   void print_screen(FILE * out)
+   {
+      fprintf(out, "---- 7up text (frame %llu)\n", (unsigned long long) frame);
+      for (int y = 0; y < BAT_HEIGHT; y++)
+      {
+         std::string s = bat_row(y);
+         if (!s.empty())
+            fprintf(out, "%2d|%s\n", y, s.c_str());
+      }
+
+      for (int y = 0; y < KING_ROWS; y++)
+      {
+         size_t last = king_text[y].find_last_not_of(' ');
+         if (last != std::string::npos)
+            fprintf(out, "K%2d|%s\n", y, king_text[y].substr(0, last + 1).c_str());
+      }
+      fprintf(out, "----\n");
+   }
+
+   flash_totals flash_now(void)
+   {
+      flash_totals t;
+
+      memset(&t, 0, sizeof(t));
+      for (int op = 0; op < FLASHSIM_OP_COUNT; op++)
+      {
+         const struct flashsim_stats * s = flashsim_stats((enum flashsim_op) op);
+
+         t.bus_reads += s->bus_reads;
+         t.sim_ns    += s->sim_ns;
+      }
+      t.programmed = flashsim_stats(FLASHSIM_OP_PROGRAM)->bytes;
+      t.erased     = flashsim_stats(FLASHSIM_OP_SECTOR_ERASE)->bytes + flashsim_stats(FLASHSIM_OP_CHIP_ERASE)->bytes;
+
+      return(t);
+   }
+};
+
+
+static Machine * machine;
+
+
+// split a script line into words; "..." holds spaces
+//
+static std::vector<std::string> split_words(const char * line)
+{
+   std::vector<std::string> words;
+   const char * p = line;
+
+   while (*p)
+   {
+      while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+         p++;
+      if ((*p == 0) || (*p == '#'))
+         break;
+
+      std::string w;
+      if (*p == '"')
+      {
+         for (p++; *p && (*p != '"'); p++)
+            w += *p;
+         if (*p == '"')
+            p++;
+      }
+      else
+      {
+         for (; *p && (*p != ' ') && (*p != '\t') && (*p != '\r') && (*p != '\n'); p++)
+            w += *p;
+      }
+      words.push_back(w);
+   }
+
+   return(words);
+}
+
+static bool parse_keys(const std::vector<std::string> & words, uint32_t * keys)
+{
+   *keys = 0;
+
+   for (size_t i = 1; i < words.size(); i++)
+   {
+      size_t k;
+
+      for (k = 0; k < sizeof(pad_keys) / sizeof(pad_keys[0]); k++)
+      {
+         if (words[i] == pad_keys[k].name)
+            break;
+      }
+
+      if (k == sizeof(pad_keys) / sizeof(pad_keys[0]))
+      {
+         printf("unknown key '%s'\n", words[i].c_str());
+         return(false);
+      }
+      *keys |= pad_keys[k].bit;
+   }
+
+   return(true);
+}
+
+static void report(const char * name, const measurement & start)
+{
+   Machine & m = *machine;
+   flash_totals f = m.flash_now();
+   uint64_t cycles = m.cpu.cycles - start.cycles;
+
+   printf("%-20s %8llu frames %12llu cycles %10.3f ms   flash: %7u read %6u programmed %4u erased %10.3f ms\n",
+          name, (unsigned long long)(m.frame - start.frame), (unsigned long long) cycles,
+          (cycles * 1000.0) / CPU_HZ, f.bus_reads - start.flash.bus_reads,
+          f.programmed - start.flash.programmed, f.erased - start.flash.erased,
+          (f.sim_ns - start.flash.sim_ns) / 1000000.0);
+}
+
+// run the script; returns the number of failed checks (stops at the first)
+//
+static int run_script(const char * filename)
+{
+   Machine & m = *machine;
+   std::map<std::string, measurement> started;
+   char line[512];
+   int lineno = 0;
+   FILE * f;
+
+   f = fopen(filename, "r");
+   if (f == NULL)
+   {
+      printf("Error: cannot open %s\n", filename);
+      return(1);
+   }
+
+   // (once the program has stopped, commands which run it return at once)
+   while (fgets(line, sizeof(line), f))
+   {
+      std::vector<std::string> w = split_words(line);
+      bool ok = true;
+      uint32_t keys;
+
+      lineno++;
+      if (w.empty())
+         continue;
+
+      if ((w[0] == "frames") && (w.size() == 2))
+         m.run_to_frame(m.frame + strtoul(w[1].c_str(), NULL, 0));
+
+      else if ((w[0] == "press") && (ok = parse_keys(w, &keys)))
+      {
+         m.pad |= keys;
+         m.run_to_frame(m.frame + PRESS_FRAMES);
+         m.pad &= ~keys;
+         m.run_to_frame(m.frame + PRESS_FRAMES);
+      }
+      else if ((w[0] == "hold") && (ok = parse_keys(w, &keys)))
+         m.pad |= keys;
+
+      else if ((w[0] == "release") && (ok = parse_keys(w, &keys)))
+         m.pad &= (w.size() == 1) ? 0 : ~keys;
+
+      else if ((w[0] == "wait_for") && (w.size() >= 2))
+      {
+         uint64_t limit = m.frame + ((w.size() > 2) ? strtoul(w[2].c_str(), NULL, 0) : WAIT_FRAMES);
+
+         while (!m.on_screen(w[1]) && (m.frame < limit) && !m.cpu.stopped)
+            m.run_to_frame(m.frame + 1);
+
+         ok = m.on_screen(w[1]);
+      }
+      else if ((w[0] == "expect") && (w.size() == 2))
+         ok = m.on_screen(w[1]);
+
+      else if ((w[0] == "expect_not") && (w.size() == 2))
+         ok = !m.on_screen(w[1]);
+
+      else if (w[0] == "screen")
+         m.print_screen(stdout);
+
+      else if ((w[0] == "begin") && (w.size() == 2))
+      {
+         measurement & s = started[w[1]];
+
+         s.cycles = m.cpu.cycles;
+         s.frame  = m.frame;
+         s.flash  = m.flash_now();
+      }
+      else if ((w[0] == "end") && (w.size() == 2) && started.count(w[1]))
+         report(w[1].c_str(), started[w[1]]);
+
+      else if ((w[0] == "save_cart") && (w.size() == 2))
+         ok = (flashsim_save(w[1].c_str()) == 0);
+
+      else if ((w[0] == "save_bram") && (w.size() == 2))
+      {
+         FILE * out = fopen(w[1].c_str(), "wb");
+
+         ok = (out != NULL);
+         for (int i = 0; ok && (i < BRAM_WINDOW); i += 2)
+            fputc(m.bram[i], out);
+         if (out)
+            fclose(out);
+      }
+      else if ((w[0] == "save_vram") && (w.size() == 2))
+      {
+         FILE * out = fopen(w[1].c_str(), "wb");
+
+         ok = (out != NULL) && (fwrite(m.vram, sizeof(m.vram), 1, out) == 1);
+         if (out)
+            fclose(out);
+      }
+      else
+      {
+         printf("%s:%d: unknown command '%s'\n", filename, lineno, w[0].c_str());
+         fclose(f);
+         return(1);
+      }
+
+      if (!ok)
+      {
+         printf("FAILED %s:%d: %s", filename, lineno, line);
+         m.print_screen(stdout);
+         fclose(f);
+         return(1);
+      }
+   }
+
+   fclose(f);
+   return(0);
+}
+
+static bool load_bram(const char * filename)
+{
+   FILE * f = fopen(filename, "rb");
+   uint8_t image[BRAM_WINDOW / 2];
+
+   if ((f == NULL) || (fread(image, 1, sizeof(image), f) != sizeof(image)))
+   {
+      printf("Error: %s is not a 32KB backup memory image\n", filename);
+      if (f)
+         fclose(f);
+      return(false);
+   }
+   fclose(f);
+
+   for (int i = 0; i < (int) sizeof(image); i++)
+      machine->bram[i << 1] = image[i];
+
+   return(true);
+}
+
+static void usage(void)
+{
+   printf("Usage:\n");
+   printf("   fxrun [-cart <image>] [-bram <32KB image>] [-max] <program.linked> [<script>]\n");
+   printf("\n");
+   printf("   -cart   starts with this image in the flash chip (else it is erased)\n");
+   printf("   -bram   starts with this image in internal backup memory (else it is blank)\n");
+   printf("   -max    uses the flash chip's maximum program and erase times, not typical\n");
+   printf("\n");
+   printf("Without a script, the program runs for %d frames and the screen is shown.\n", DEFAULT_FRAMES);
+   printf("Script commands, one per line ('#' starts a remark):\n");
+   printf("   frames <n>                 run for n frames\n");
+   printf("   press <key>...             hold the keys for %d frames, then release them for %d\n", PRESS_FRAMES, PRESS_FRAMES);
+   printf("   hold <key>... / release [<key>...]\n");
+   printf("                              (keys: I II III IV V VI SELECT RUN UP DOWN LEFT RIGHT)\n");
+   printf("   wait_for \"<text>\" [<n>]    run until the text is on the screen (fails after n frames, %d)\n", WAIT_FRAMES);
+   printf("   expect \"<text>\"            fails unless the text is on the screen\n");
+   printf("   expect_not \"<text>\"        fails if it is\n");
+   printf("   screen                     show the text on the screen\n");
+   printf("   begin <name> / end <name>  report frames, CPU cycles and flash activity between them\n");
+   printf("   save_cart / save_bram / save_vram <file>\n");
+}
+
+int main(int argc, char *argv[])
+{
+const struct flashsim_timing * timing = &flashsim_typical;
+const char * cart = NULL;
+const char * bram = NULL;
+const char * program = NULL;
+const char * script = NULL;
+int failed = 0;
+int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if ((strcmp(argv[i], "-cart") == 0) && (i + 1 < argc))
+         cart = argv[++i];
+      else if ((strcmp(argv[i], "-bram") == 0) && (i + 1 < argc))
+         bram = argv[++i];
+      else if (strcmp(argv[i], "-max") == 0)
+         timing = &flashsim_maximum;
+      else if ((argv[i][0] != '-') && (program == NULL))
+         program = argv[i];
+      else if ((argv[i][0] != '-') && (script == NULL))
+         script = argv[i];
+      else
+      {
+         usage();
+         return(2);
+      }
+   }
+
+   if (program == NULL)
+   {
+      usage();
+      return(2);
+   }
+
+   machine = new Machine;
+   flashsim_reset(timing);
+
+   if (cart && (flashsim_load(cart) != 0))
+   {
+      printf("Error: cannot read %s\n", cart);
+      return(2);
+   }
+
+   if ((bram && !load_bram(bram)) || !machine->load_elf(program))
+      return(2);
+
+   machine->install_stubs();
+
+   if (script)
+      failed = run_script(script);
+   else
+   {
+      machine->run_to_frame(DEFAULT_FRAMES);
+      machine->print_screen(stdout);
+   }
+
+   if (machine->cpu.stopped)
+   {
+      printf("%s\n", machine->cpu.fault);
+      if (!script)
+         machine->print_screen(stdout);
+   }
+
+   measurement zero;
+   memset(&zero, 0, sizeof(zero));
+   report("total", zero);
+   flashsim_report(stdout);
+
+   if (failed || (machine->cpu.stopped && (strncmp(machine->cpu.fault, "program ended", 13) != 0)))
+      return(1);
+
+   return(0);
+}
@@ -0,0 +1,158 @@
+// (c) 2023 David Shadoff
+//
+// lzss.cpp - the LZSS encoding used for the packed boot image (unlzss.s)
+//
+#include <cstring>
+#include <algorithm>
+#include "lzss.h"
+
+#define WINDOW           4096            // LZSS parameters - must match unlzss.s
+#define MIN_MATCH        3
+#define MAX_MATCH        18
+#define MAX_CHAIN        64              // candidate matches examined per position
+
+
+// Same stream as mkflashboot.py produced (and unlzss.s expects): a flag
+// byte per 8 items (bit set = literal), and matches as 2 bytes holding
+// a 12-bit distance-1 and a 4-bit length-MIN_MATCH.  Candidates are kept
+// in hash chains on the next MIN_MATCH bytes, most recent first.
+//
+bytes lzss_compress(const bytes & data)
+{
+bytes out;
+int n = data.size();
+std::vector<int> head(1 << 16, -1);
+std::vector<int> prev(n, -1);
+
+   auto hash = [&](int p) {
+      return(((data[p] << 8) ^ (data[p+1] << 4) ^ data[p+2]) & 0xFFFF);
+   };
+
+   auto add_position = [&](int p) {
+      if (p + MIN_MATCH <= n)
+      {
+         int h = hash(p);
+         prev[p] = head[h];
+         head[h] = p;
+      }
+   };
+
+   int pos = 0;
+   while (pos < n)
+   {
+      int flag_pos = out.size();
+      int flags = 0;
+      out.push_back(0);
+
+      for (int bit = 0; bit < 8; bit++)
+      {
+         if (pos >= n)
+            break;
+
+         int best_len = 0;
+         int best_dist = 0;
+
+         if (pos + MIN_MATCH <= n)
+         {
+            int limit = std::min(MAX_MATCH, n - pos);
+            int seen = 0;
+
+            for (int cand = head[hash(pos)]; cand >= 0; cand = prev[cand])
+            {
+               int dist = pos - cand;
+               if (dist > WINDOW)
+                  break;
+
+               // the hash is not exact, and only the most recent MAX_CHAIN
+               // positions with the same prefix are examined
+               if (memcmp(&data[cand], &data[pos], MIN_MATCH) != 0)
+                  continue;
+               if (++seen > MAX_CHAIN)
+                  break;
+
+               int length = MIN_MATCH;
+               while ((length < limit) && (data[cand + length] == data[pos + length]))
+                  length++;
+
+               if (length > best_len)
+               {
+                  best_len = length;
+                  best_dist = dist;
+                  if (length == limit)
+                     break;
+               }
+            }
+         }
+
+         if (best_len >= MIN_MATCH)
+         {
+            int d = best_dist - 1;
+            out.push_back(d & 0xFF);
+            out.push_back(((d >> 8) << 4) | (best_len - MIN_MATCH));
+            for (int p = pos; p < pos + best_len; p++)
+               add_position(p);
+            pos += best_len;
+         }
+         else
+         {
+            flags |= (1 << bit);
+            out.push_back(data[pos]);
+            add_position(pos);
+            pos++;
+         }
+      }
+
+      out[flag_pos] = flags;
+   }
+
+   return(out);
+}
+
+
+// as unlzss.s does it; 'length' is the unpacked length (stored
+// ahead of the stream in the boot image).  Returns false if the
+// stream is damaged.
+//
+bool lzss_decompress(const uint8_t * in, size_t in_len, uint8_t * out, size_t length)
+{
+size_t src = 0, dst = 0;
+int flags = 0, bits = 0;
+
+   while (dst < length)
+   {
+      if (bits == 0)
+      {
+         if (src >= in_len)
+            return(false);
+         flags = in[src++];
+         bits = 8;
+      }
+
+      if (flags & 1)
+      {
+         if (src >= in_len)
+            return(false);
+         out[dst++] = in[src++];
+      }
+      else
+      {
+         if (src + 2 > in_len)
+            return(false);
+
+         size_t dist = (in[src] | ((in[src+1] & 0xF0) << 4)) + 1;
+         size_t len  = (in[src+1] & 0x0F) + MIN_MATCH;
+         src += 2;
+
+         if (dist > dst)
+            return(false);
+
+         for (size_t i = 0; (i < len) && (dst < length); i++, dst++)
+            out[dst] = out[dst - dist];
+      }
+
+      flags >>= 1;
+      bits--;
+   }
+
+   return(true);
+}
@@ -0,0 +1,17 @@
+// (c) 2023 David Shadoff
+//
+// lzss.h - the LZSS encoding used for the packed boot image (unlzss.s)
+//
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes;
+
+bytes lzss_compress(const bytes & data);
+bool  lzss_decompress(const uint8_t * in, size_t in_len, uint8_t * out, size_t length);
+
+#endif
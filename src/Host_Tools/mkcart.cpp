@@ -0,0 +1,656 @@
+// (c) 2023 David Shadoff
+//
+// mkcart - build FX-BMP cart images for FX-Flash cartridges
+//
+// An image holds the FX-BMP/'PCFXBoot' boot sector, the program (optionally
+// LZSS-compressed behind the unlzss.s stub), the overlay of cold screens,
+// and optionally pre-populated save slots - each with its date/comment
+// metadata, directory-name index and CRC, exactly as bank.c writes them.
+//
+// Each image is checked after it is built.  With '-batch', many images
+// (one per line of the batch file) are built in parallel.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "lzss.h"
+
+extern "C" {
+#include "../Core/bram.h"              // slot layout and FAT, as the Backup Manager uses them
+}
+
+// cart layout - must match bank.c and unlzss.s
+//
+#define PROGRAM_ADDR     0x8000          // where the program runs
+#define STUB_ADDR        0x180000        // where the stub and packed program are loaded
+#define FLASH_OFFSET     0x1000          // program location within the flash
+#define MEDNAFEN_SIZE    (128 * 1024)
+
+#define BRAM_SIZE        32768
+#define DATE_LENGTH      10              // YYYY-MM-DD
+
+#define ERASED           0xFF
+
+
+struct slot_spec
+{
+   int         slot;        // 1-relative, as shown by the Backup Manager
+   std::string file;
+   std::string date;
+   std::string comment;
+};
+
+struct cart_spec
+{
+   bool        mednafen = false;
+   std::string program;
+   std::string stub;
+   std::string overlay;
+   std::string output;
+   std::vector<slot_spec> slots;
+};
+
+
+static uint32_t cart_crc_table[256];
+
+static void cart_crc32_init(void)
+{
+   for (uint32_t i = 0; i < 256; i++)
+   {
+      uint32_t c = i;
+      for (int j = 0; j < 8; j++)
+         c = (c & 1) ? ((c >> 1) ^ 0xEDB88320) : (c >> 1);
+      cart_crc_table[i] = c;
+   }
+}
+
+static uint32_t cart_crc32(const uint8_t * buf, int len)
+{
+uint32_t crc = 0xFFFFFFFF;
+
+   for (int i = 0; i < len; i++)
+      crc = cart_crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+
+   return(~crc);
+}
+
+static void put32(bytes & out, uint32_t value)
+{
+   for (int i = 0; i < 4; i++)
+      out.push_back((value >> (i * 8)) & 0xFF);
+}
+
+static void poke32(uint8_t * p, uint32_t value)
+{
+   for (int i = 0; i < 4; i++)
+      p[i] = (value >> (i * 8)) & 0xFF;
+}
+
+static uint32_t peek32(const uint8_t * p)
+{
+   return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static bool read_file(const std::string & name, bytes & data, std::string & err)
+{
+FILE * f;
+uint8_t buf[4096];
+size_t n;
+
+   f = fopen(name.c_str(), "rb");
+   if (f == NULL)
+   {
+      err = "cannot open " + name;
+      return(false);
+   }
+
+   data.clear();
+   while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      data.insert(data.end(), buf, buf + n);
+
+   fclose(f);
+   return(true);
+}
+
+
+// the boot sector, identifying the cart as FX-BMP type
+// and telling the firmware where to load the program
+//
+static void write_boot_sector(uint8_t * img, uint32_t load_addr, uint32_t length)
+{
+static const uint8_t bootseq[] = {
+   0x24, 0x8A, 0xDF, 'P','C','F','X','C','a','r','d',
+   0x80, 0x00, 0x01, 0x01, 0x00,
+   0x01, 0x40, 0x00, 0x00, 0x01, 0xf9, 0x03, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+   memcpy(img, bootseq, sizeof(bootseq));
+
+   // offset 0x28: boot sequence
+   memcpy(img + 0x28, "PCFXBoot", 8);
+   poke32(img + 0x30, FLASH_OFFSET);    // backup memory source offset
+   poke32(img + 0x34, load_addr);       // RAM destination
+   poke32(img + 0x38, length);          // transfer size (bytes)
+   poke32(img + 0x3C, load_addr);       // transfer address
+}
+
+static bool bram_formatted(const uint8_t * bram)
+{
+   return(memcmp(bram + 3, "PCFXSram", 8) == 0);
+}
+
+// a slot as buffer_to_flash() leaves it: the 32KB of BRAM, then in the
+// metadata sector the date, comment, CRC and the directory-name index
+//
+static void write_slot(uint8_t * img, const slot_spec & s, const bytes & bram)
+{
+uint8_t * slot = img + FLASH_BANK_BASE + ((s.slot - 1) * FLASH_BANK_SIZE);
+uint8_t * meta = slot + FLASH_BANK_CMNT;
+int count = 0;
+
+   memcpy(slot, bram.data(), BRAM_SIZE);
+
+   memset(meta, 0, COMMENT_OFFSET);
+   memcpy(meta, s.date.data(), s.date.size());
+
+   memset(meta + COMMENT_OFFSET, ' ', COMMENT_LENGTH);
+   memcpy(meta + COMMENT_OFFSET, s.comment.data(), std::min<size_t>(s.comment.size(), COMMENT_LENGTH));
+   meta[COMMENT_OFFSET + COMMENT_LENGTH] = 0;
+
+   meta[CRC_OFFSET] = 'C';
+   meta[CRC_OFFSET + 1] = 'K';
+   poke32(meta + CRC_OFFSET + 2, cart_crc32(bram.data(), BRAM_SIZE));
+
+   // directory names, in the same form as get_buffer_directory()
+   for (int i = FAT_DIR_OFFSET_32K; i < FAT_DIR_OFFSET_32K + (FAT_DIR_ENTRIES_32K * FAT_DIR_ENTRY_SIZE); i += FAT_DIR_ENTRY_SIZE)
+   {
+      if (bram[i] == 0)
+         break;
+      if ((bram[i] == '.') || (bram[i] == 0xE5))
+         continue;
+
+      uint8_t * name = meta + INDEX_NAMES + (count * INDEX_NAME_SIZE);
+      memcpy(name, &bram[i], 8);
+      memcpy(name + 8, &bram[i + 12], 9);
+      count++;
+   }
+
+   meta[INDEX_OFFSET] = 'I';
+   meta[INDEX_OFFSET + 1] = 'X';
+   meta[INDEX_OFFSET + 2] = count;
+}
+
+static bool valid_date(const std::string & date)
+{
+   if (date.size() != DATE_LENGTH)
+      return(false);
+
+   for (int i = 0; i < DATE_LENGTH; i++)
+   {
+      if ((i == 4) || (i == 7))
+      {
+         if (date[i] != '-')
+            return(false);
+      }
+      else if ((date[i] < '0') || (date[i] > '9'))
+         return(false);
+   }
+   return(true);
+}
+
+
+// re-read a finished image the way the firmware and bank.c will
+//
+static bool check_image(const bytes & img, const cart_spec & spec, std::string & err)
+{
+char msg[128];
+
+   if ((memcmp(&img[3], "PCFXCard", 8) != 0) || (memcmp(&img[0x28], "PCFXBoot", 8) != 0))
+   {
+      err = "boot sector is not FX-BMP bootable";
+      return(false);
+   }
+
+   uint32_t source = peek32(&img[0x30]);
+   uint32_t length = peek32(&img[0x38]);
+   uint32_t limit  = spec.overlay.empty() ? FLASH_BANK_BASE : OVERLAY_FLASH;
+
+   if ((source != FLASH_OFFSET) || (length == 0) || (source + length > limit) || (source + length > img.size()))
+   {
+      snprintf(msg, sizeof(msg), "boot transfer of %u bytes at 0x%X does not fit", length, source);
+      err = msg;
+      return(false);
+   }
+
+   if (!spec.overlay.empty())
+   {
+      const uint8_t * ovl = &img[OVERLAY_FLASH];
+      uint32_t len = peek32(ovl + 4);
+      uint32_t sum = 0;
+
+      if ((memcmp(ovl, "OVL", 4) != 0) || (len + OVERLAY_HEADER > OVERLAY_FLASH_SIZE))
+      {
+         err = "overlay header is damaged";
+         return(false);
+      }
+      for (uint32_t i = 0; i < len; i++)
+         sum += ovl[OVERLAY_HEADER + i];
+
+      if (sum != peek32(ovl + 8))
+      {
+         err = "overlay sum does not match";
+         return(false);
+      }
+   }
+
+   for (const slot_spec & s : spec.slots)
+   {
+      const uint8_t * slot = &img[FLASH_BANK_BASE + ((s.slot - 1) * FLASH_BANK_SIZE)];
+      const uint8_t * meta = slot + FLASH_BANK_CMNT;
+
+      if (!bram_formatted(slot) ||
+          (meta[CRC_OFFSET] != 'C') || (meta[CRC_OFFSET + 1] != 'K') ||
+          (peek32(meta + CRC_OFFSET + 2) != cart_crc32(slot, BRAM_SIZE)) ||
+          (meta[INDEX_OFFSET] != 'I') || (meta[INDEX_OFFSET + 1] != 'X') ||
+          (meta[INDEX_OFFSET + 2] > FAT_DIR_ENTRIES_32K))
+      {
+         snprintf(msg, sizeof(msg), "slot %d does not verify", s.slot);
+         err = msg;
+         return(false);
+      }
+   }
+
+   return(true);
+}
+
+
+static bool build_cart(const cart_spec & spec, std::string & log, std::string & err)
+{
+bytes program, stub, overlay;
+uint32_t load_addr = PROGRAM_ADDR;
+char msg[256];
+
+   if (!read_file(spec.program, program, err))
+      return(false);
+
+   if (!spec.stub.empty())
+   {
+      if (!read_file(spec.stub, stub, err))
+         return(false);
+      while ((stub.size() % 4) != 0)
+         stub.push_back(0);
+
+      bytes packed = lzss_compress(program);
+      snprintf(msg, sizeof(msg), "program: %d bytes, packed: %d bytes (+ %d byte stub)\n",
+               (int)program.size(), (int)packed.size(), (int)stub.size());
+      log += msg;
+
+      bytes boot = stub;
+      put32(boot, program.size());
+      boot.insert(boot.end(), packed.begin(), packed.end());
+      program.swap(boot);
+      load_addr = STUB_ADDR;
+   }
+
+   uint32_t length = program.size();
+   uint32_t program_limit = spec.overlay.empty() ? FLASH_BANK_BASE : OVERLAY_FLASH;
+
+   if (FLASH_OFFSET + length > program_limit)
+   {
+      snprintf(msg, sizeof(msg), "boot image does not fit in the reserved area (%d bytes over)",
+               (int)(FLASH_OFFSET + length - program_limit));
+      err = msg;
+      return(false);
+   }
+
+   // overlay, with its header: 'OVL', 0, then length and byte sum
+   //
+   if (!spec.overlay.empty())
+   {
+      bytes ovl;
+      uint32_t sum = 0;
+
+      if (!read_file(spec.overlay, ovl, err))
+         return(false);
+
+      if (ovl.size() + OVERLAY_HEADER > OVERLAY_FLASH_SIZE)
+      {
+         snprintf(msg, sizeof(msg), "overlay is %d bytes too large", (int)(ovl.size() + OVERLAY_HEADER - OVERLAY_FLASH_SIZE));
+         err = msg;
+         return(false);
+      }
+
+      for (uint8_t b : ovl)
+         sum += b;
+
+      overlay.assign((const uint8_t *)"OVL", (const uint8_t *)"OVL" + 4);
+      put32(overlay, ovl.size());
+      put32(overlay, sum);
+      overlay.insert(overlay.end(), ovl.begin(), ovl.end());
+
+      snprintf(msg, sizeof(msg), "overlay: %d of %d bytes\n", (int)overlay.size(), OVERLAY_FLASH_SIZE);
+      log += msg;
+   }
+
+   snprintf(msg, sizeof(msg), "boot image: %d of %d bytes\n", (int)(FLASH_OFFSET + length), (int)program_limit);
+   log += msg;
+
+   // the image: the program's part of the reserved area is zero-filled
+   // as before; the settings and telemetry sectors, and slots which are
+   // not populated, are left as erased flash for the Backup Manager
+   //
+   uint32_t size = FLASH_OFFSET + length;
+
+   if (!overlay.empty())
+      size = OVERLAY_FLASH + overlay.size();
+
+   for (const slot_spec & s : spec.slots)
+      size = std::max<uint32_t>(size, FLASH_BANK_BASE + (s.slot * FLASH_BANK_SIZE));
+
+   if (spec.mednafen)
+      size = std::max<uint32_t>(size, MEDNAFEN_SIZE);
+
+   bytes img(size, 0);
+   if (size > CONFIG_FLASH)
+      memset(&img[CONFIG_FLASH], ERASED, size - CONFIG_FLASH);
+
+   write_boot_sector(&img[0], load_addr, length);
+   memcpy(&img[FLASH_OFFSET], program.data(), length);
+
+   if (!overlay.empty())
+      memcpy(&img[OVERLAY_FLASH], overlay.data(), overlay.size());
+
+   for (const slot_spec & s : spec.slots)
+   {
+      bytes bram;
+
+      if (!read_file(s.file, bram, err))
+         return(false);
+
+      if ((bram.size() != BRAM_SIZE) || !bram_formatted(bram.data()))
+      {
+         err = s.file + " is not a 32KB formatted BRAM image";
+         return(false);
+      }
+
+      write_slot(&img[0], s, bram);
+
+      snprintf(msg, sizeof(msg), "slot %2d: %s %-18s %s\n", s.slot, s.date.c_str(), s.comment.c_str(), s.file.c_str());
+      log += msg;
+   }
+
+   if (!check_image(img, spec, err))
+      return(false);
+
+   FILE * f = fopen(spec.output.c_str(), "wb");
+   if (f == NULL)
+   {
+      err = "cannot create " + spec.output;
+      return(false);
+   }
+   if (fwrite(img.data(), 1, img.size(), f) != img.size())
+   {
+      fclose(f);
+      err = "cannot write " + spec.output;
+      return(false);
+   }
+   fclose(f);
+
+   return(true);
+}
+
+
+static bool parse_args(const std::vector<std::string> & args, cart_spec & spec, std::string & err)
+{
+size_t i = 0;
+
+   while (i < args.size())
+   {
+      const std::string & arg = args[i++];
+      bool has_value = (i < args.size());
+
+      if (arg == "-mednafen")
+         spec.mednafen = true;
+      else if ((arg == "-stub") && has_value)
+         spec.stub = args[i++];
+      else if ((arg == "-overlay") && has_value)
+         spec.overlay = args[i++];
+      else if ((arg == "-o") && has_value)
+         spec.output = args[i++];
+      else if ((arg == "-slot") && (i + 1 < args.size()))
+      {
+         slot_spec s;
+
+         s.slot = atoi(args[i++].c_str());
+         s.file = args[i++];
+         s.date = "2023-01-07";       // default_date in bank.c
+         s.comment = "";
+
+         if ((s.slot < 1) || (s.slot > MAX_SLOTS))
+         {
+            err = "slot number must be 1 to 12";
+            return(false);
+         }
+         for (const slot_spec & other : spec.slots)
+         {
+            if (other.slot == s.slot)
+            {
+               err = "slot " + std::to_string(s.slot) + " is given twice";
+               return(false);
+            }
+         }
+         spec.slots.push_back(s);
+      }
+      else if ((arg == "-date") && has_value && !spec.slots.empty())
+      {
+         spec.slots.back().date = args[i++];
+         if (!valid_date(spec.slots.back().date))
+         {
+            err = "date must be YYYY-MM-DD";
+            return(false);
+         }
+      }
+      else if ((arg == "-comment") && has_value && !spec.slots.empty())
+      {
+         spec.slots.back().comment = args[i++];
+         if (spec.slots.back().comment.size() > COMMENT_LENGTH)
+         {
+            err = "comment is longer than 18 characters";
+            return(false);
+         }
+      }
+      else if ((arg[0] != '-') && spec.program.empty())
+         spec.program = arg;
+      else
+      {
+         err = "unexpected argument '" + arg + "'";
+         return(false);
+      }
+   }
+
+   if (spec.program.empty())
+   {
+      err = "no program given";
+      return(false);
+   }
+
+   if (spec.output.empty())
+      spec.output = spec.program + ".bootflash";
+
+   return(true);
+}
+
+// one cart per line: the same arguments as the command line, with
+// double quotes around arguments holding spaces; '#' starts a comment
+//
+static bool read_batch(const std::string & name, std::vector<cart_spec> & carts, std::string & err)
+{
+bytes text;
+
+   if (!read_file(name, text, err))
+      return(false);
+
+   text.push_back('\n');
+
+   std::vector<std::string> args;
+   std::string arg;
+   bool in_arg = false, quoted = false, comment = false;
+   int line = 1;
+
+   for (uint8_t c : text)
+   {
+      if (c == '\n')
+      {
+         if (quoted)
+         {
+            err = name + ":" + std::to_string(line) + ": unterminated quote";
+            return(false);
+         }
+         if (in_arg)
+            args.push_back(arg);
+         if (!args.empty())
+         {
+            cart_spec spec;
+            if (!parse_args(args, spec, err))
+            {
+               err = name + ":" + std::to_string(line) + ": " + err;
+               return(false);
+            }
+            carts.push_back(spec);
+         }
+         args.clear();
+         arg.clear();
+         in_arg = quoted = comment = false;
+         line++;
+      }
+      else if (comment || (c == '\r'))
+         continue;
+      else if (c == '"')
+      {
+         quoted = !quoted;
+         in_arg = true;
+      }
+      else if (quoted)
+         arg += c;
+      else if (c == '#')
+         comment = true;
+      else if ((c == ' ') || (c == '\t'))
+      {
+         if (in_arg)
+            args.push_back(arg);
+         arg.clear();
+         in_arg = false;
+      }
+      else
+      {
+         arg += c;
+         in_arg = true;
+      }
+   }
+
+   return(true);
+}
+
+
+static void usage(void)
+{
+   printf("Usage:\n");
+   printf("   mkcart [-mednafen] [-stub <unlzss.bin>] [-overlay <file.ovl>] [-o <output>]\n");
+   printf("          [-slot <n> <bram.bin> [-date YYYY-MM-DD] [-comment <text>]]... <program>\n");
+   printf("   mkcart [-j <jobs>] -batch <file>\n");
+   printf("\n");
+   printf("   The image is written to <program>.bootflash unless '-o' is given.\n");
+   printf("   A batch file lists one cart per line, with the arguments above.\n");
+}
+
+int main(int argc, char *argv[])
+{
+std::vector<std::string> args(argv + 1, argv + argc);
+std::vector<cart_spec> carts;
+std::string batch, err;
+int jobs = std::thread::hardware_concurrency();
+
+   cart_crc32_init();
+
+   if ((args.size() >= 2) && (args[0] == "-j"))
+   {
+      jobs = atoi(args[1].c_str());
+      args.erase(args.begin(), args.begin() + 2);
+   }
+
+   if ((args.size() == 2) && (args[0] == "-batch"))
+   {
+      if (!read_batch(args[1], carts, err))
+      {
+         fprintf(stderr, "Error: %s\n", err.c_str());
+         return(1);
+      }
+   }
+   else
+   {
+      cart_spec spec;
+
+      if (args.empty())
+      {
+         usage();
+         return(1);
+      }
+      if (!parse_args(args, spec, err))
+      {
+         fprintf(stderr, "Error: %s\n", err.c_str());
+         usage();
+         return(1);
+      }
+      carts.push_back(spec);
+   }
+
+   if (jobs < 1)
+      jobs = 1;
+   if (jobs > (int)carts.size())
+      jobs = carts.size();
+
+   // each worker takes the next cart; output is kept per cart
+   // and printed in order afterwards, so it is not interleaved
+   //
+   std::vector<std::string> logs(carts.size()), errors(carts.size());
+   std::vector<char> ok(carts.size(), 0);
+   std::atomic<size_t> next(0);
+   std::vector<std::thread> workers;
+
+   auto worker = [&]() {
+      size_t n;
+      while ((n = next++) < carts.size())
+         ok[n] = build_cart(carts[n], logs[n], errors[n]);
+   };
+
+   for (int i = 1; i < jobs; i++)
+      workers.emplace_back(worker);
+   worker();
+   for (std::thread & t : workers)
+      t.join();
+
+   int failed = 0;
+   for (size_t n = 0; n < carts.size(); n++)
+   {
+      if (carts.size() > 1)
+         printf("%s:\n", carts[n].output.c_str());
+      fputs(logs[n].c_str(), stdout);
+
+      if (!ok[n])
+      {
+         fprintf(stderr, "Error: %s: %s\n", carts[n].output.c_str(), errors[n].c_str());
+         failed++;
+      }
+   }
+
+   if (carts.size() > 1)
+      printf("%d of %d cart images built\n", (int)carts.size() - failed, (int)carts.size());
+
+   return(failed ? 1 : 0);
+}
@@ -0,0 +1,637 @@
+// (c) 2023 David Shadoff
+//
+// v810.cpp - interpreter for the NEC V810 CPU (see v810.h)
+//
+// Execution times are the V810 user's manual figures for an instruction
+// following one of the same kind, without wait states.  Where the manual
+// gives a range (floating point, bit strings), a middle value is used.
+//
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include "v810.h"
+
+#define TIME_ALU         1
+#define TIME_BRANCH      3               // taken Bcond, JR, JAL, JMP
+#define TIME_LOAD        4
+#define TIME_STORE       4
+#define TIME_MUL         13
+#define TIME_DIV         38
+#define TIME_DIVU        36
+#define TIME_CAXI        26
+#define TIME_SEI_CLI     12
+#define TIME_RETI        10
+#define TIME_TRAP        15
+#define TIME_INTERRUPT   10
+#define TIME_FLOAT       18              // ADDF/SUBF/MULF
+#define TIME_DIVF        44
+#define TIME_CMPF        8
+#define TIME_CVT         12
+#define TIME_BIT_STRING  20              // plus one cycle for every 4 bits
+
+#define SEXT(v, bits)    ((int32_t)((uint32_t)(v) << (32 - (bits))) >> (32 - (bits)))
+
+
+V810::V810(V810Bus & b) : bus(b)
+{
+   reset(0);
+}
+
+void V810::reset(uint32_t entry)
+{
+   memset(r, 0, sizeof(r));
+   memset(sr, 0, sizeof(sr));
+
+   // PSW is as the boot firmware leaves it when a program starts
+   // (not NP, as at reset), with interrupts disabled
+   sr[V810_PSW]  = PSW_ID;
+   sr[V810_ECR]  = 0x0000FFF0;
+   sr[V810_PIR]  = 0x00005346;      // V810
+   sr[V810_TKCW] = 0x000000E0;
+
+   pc = entry;
+   cycles = 0;
+   irq_level = -1;
+   halted = false;
+   stopped = false;
+   fault[0] = 0;
+}
+
+void V810::stop(const char * why)
+{
+   snprintf(fault, sizeof(fault), "%s at %08X", why, pc);
+   stopped = true;
+}
+
+bool V810::condition(int cond)
+{
+uint32_t psw = sr[V810_PSW];
+bool z  = psw & PSW_Z;
+bool s  = psw & PSW_S;
+bool ov = psw & PSW_OV;
+bool cy = psw & PSW_CY;
+bool result;
+
+   switch (cond & 7)
+   {
+      case 0:  result = ov;                break;    // V
+      case 1:  result = cy;                break;    // C / L
+      case 2:  result = z;                 break;    // Z / E
+      case 3:  result = cy || z;           break;    // NH
+      case 4:  result = s;                 break;    // N
+      case 5:  result = true;              break;    // T
+      case 6:  result = s != ov;           break;    // LT
+      default: result = (s != ov) || z;    break;    // LE
+   }
+
+   return((cond & 8) ? !result : result);
+}
+
+void V810::set_zs(uint32_t v)
+{
+   sr[V810_PSW] &= ~(PSW_Z | PSW_S | PSW_OV);
+   if (v == 0)
+      sr[V810_PSW] |= PSW_Z;
+   if (v & 0x80000000)
+      sr[V810_PSW] |= PSW_S;
+}
+
+uint32_t V810::add(uint32_t a, uint32_t b)
+{
+uint32_t res = a + b;
+
+   set_zs(res);
+   sr[V810_PSW] &= ~PSW_CY;
+   if (res < a)
+      sr[V810_PSW] |= PSW_CY;
+   if (((a ^ res) & (b ^ res)) & 0x80000000)
+      sr[V810_PSW] |= PSW_OV;
+
+   return(res);
+}
+
+// a - b
+uint32_t V810::sub(uint32_t a, uint32_t b)
+{
+uint32_t res = a - b;
+
+   set_zs(res);
+   sr[V810_PSW] &= ~PSW_CY;
+   if (a < b)
+      sr[V810_PSW] |= PSW_CY;
+   if (((a ^ b) & (a ^ res)) & 0x80000000)
+      sr[V810_PSW] |= PSW_OV;
+
+   return(res);
+}
+
+uint32_t V810::shl(uint32_t v, int n)
+{
+uint32_t res = (n == 0) ? v : (v << n);
+
+   set_zs(res);
+   sr[V810_PSW] &= ~PSW_CY;
+   if ((n != 0) && ((v >> (32 - n)) & 1))
+      sr[V810_PSW] |= PSW_CY;
+
+   return(res);
+}
+
+uint32_t V810::shr(uint32_t v, int n)
+{
+uint32_t res = (n == 0) ? v : (v >> n);
+
+   set_zs(res);
+   sr[V810_PSW] &= ~PSW_CY;
+   if ((n != 0) && ((v >> (n - 1)) & 1))
+      sr[V810_PSW] |= PSW_CY;
+
+   return(res);
+}
+
+uint32_t V810::sar(uint32_t v, int n)
+{
+uint32_t res = (n == 0) ? v : (uint32_t)((int32_t) v >> n);
+
+   set_zs(res);
+   sr[V810_PSW] &= ~PSW_CY;
+   if ((n != 0) && ((v >> (n - 1)) & 1))
+      sr[V810_PSW] |= PSW_CY;
+
+   return(res);
+}
+
+void V810::set_float(float f)
+{
+   sr[V810_PSW] &= ~(PSW_Z | PSW_S | PSW_OV | PSW_CY);
+   if (f == 0)
+      sr[V810_PSW] |= PSW_Z;
+   if (f < 0)
+      sr[V810_PSW] |= PSW_S | PSW_CY;
+}
+
+void V810::ldsr(int reg, uint32_t value)
+{
+   switch (reg)
+   {
+      case V810_ECR:
+      case V810_PIR:
+      case V810_TKCW:
+         break;                     // read only
+
+      case V810_PSW:
+         sr[reg] = value & 0x000FF3FF;
+         break;
+
+      default:
+         sr[reg] = value;
+         break;
+   }
+}
+
+void V810::interrupt(int level)
+{
+   sr[V810_EIPC]  = pc;
+   sr[V810_EIPSW] = sr[V810_PSW];
+   sr[V810_ECR]   = (sr[V810_ECR] & 0xFFFF0000) | (0xFE00 + (level << 4));
+
+   sr[V810_PSW] |= PSW_EP | PSW_ID;
+   sr[V810_PSW] &= ~(PSW_AE | PSW_I_MASK);
+   sr[V810_PSW] |= ((level < 15) ? (level + 1) : 15) << PSW_I_SHIFT;
+
+   pc = bus.irq_vector(level);
+   halted = false;
+   cycles += TIME_INTERRUPT;
+}
+
+// bit string instructions: r30/r27 is the source word and bit,
+// r29/r26 the destination (or, for searches, the count of bits
+// skipped), and r28 the length in bits
+//
+void V810::bit_string(int sub)
+{
+uint32_t len = r[28];
+
+   cycles += TIME_BIT_STRING + (len / 4);
+
+   if (sub < 8)
+   {
+      uint32_t want = (sub >> 1) & 1;
+      bool down = sub & 1;
+      uint32_t addr = r[30] & ~3;
+      int bit = r[27] & 31;
+      uint32_t word = bus.read(addr, 4);
+      uint32_t skipped = 0;
+      bool found = false;
+
+      while (len != 0)
+      {
+         if (((word >> bit) & 1) == want)
+         {
+            found = true;
+            break;
+         }
+
+         skipped++;
+         len--;
+
+         if (down)
+         {
+            if (bit-- == 0)
+            {
+               bit = 31;
+               addr -= 4;
+               if (len)
+                  word = bus.read(addr, 4);
+            }
+         }
+         else if (++bit == 32)
+         {
+            bit = 0;
+            addr += 4;
+            if (len)
+               word = bus.read(addr, 4);
+         }
+      }
+
+      r[29] += skipped;
+      r[28] = len;
+      r[30] = addr;
+      r[27] = bit;
+
+      sr[V810_PSW] &= ~PSW_Z;
+      if (!found)
+         sr[V810_PSW] |= PSW_Z;
+      return;
+   }
+
+   uint32_t src = r[30] & ~3;
+   uint32_t dst = r[29] & ~3;
+   int sbit = r[27] & 31;
+   int dbit = r[26] & 31;
+   uint32_t s = bus.read(src, 4);
+   uint32_t d = bus.read(dst, 4);
+   bool dirty = false;
+
+   while (len != 0)
+   {
+      uint32_t a = (s >> sbit) & 1;
+      uint32_t b = (d >> dbit) & 1;
+      uint32_t res;
+
+      switch (sub & 7)
+      {
+         case 0:  res = b | a;         break;    // ORBSU
+         case 1:  res = b & a;         break;    // ANDBSU
+         case 2:  res = b ^ a;         break;    // XORBSU
+         case 3:  res = a;             break;    // MOVBSU
+         case 4:  res = b | (a ^ 1);   break;    // ORNBSU
+         case 5:  res = b & (a ^ 1);   break;    // ANDNBSU
+         case 6:  res = b ^ (a ^ 1);   break;    // XORNBSU
+         default: res = a ^ 1;         break;    // NOTBSU
+      }
+
+      d = (d & ~(1u << dbit)) | (res << dbit);
+      dirty = true;
+      len--;
+
+      if (++sbit == 32)
+      {
+         sbit = 0;
+         src += 4;
+         if (len)
+            s = bus.read(src, 4);
+      }
+
+      if (++dbit == 32)
+      {
+         bus.write(dst, d, 4);
+         dirty = false;
+         dbit = 0;
+         dst += 4;
+         if (len)
+            d = bus.read(dst, 4);
+      }
+   }
+
+   if (dirty)
+      bus.write(dst, d, 4);
+
+   r[28] = 0;
+   r[30] = src;
+   r[27] = sbit;
+   r[29] = dst;
+   r[26] = dbit;
+}
+
+void V810::step(void)
+{
+uint32_t psw = sr[V810_PSW];
+
+   if ((irq_level >= 0) && !(psw & (PSW_ID | PSW_EP | PSW_NP)) &&
+       (irq_level >= (int)((psw & PSW_I_MASK) >> PSW_I_SHIFT)) && bus.irq_vector(irq_level))
+   {
+      interrupt(irq_level);
+      return;
+   }
+
+   if (halted)
+   {
+      cycles += TIME_ALU;
+      return;
+   }
+
+uint32_t inst = bus.read(pc, 2);
+int op = inst >> 10;
+int r1 = inst & 31;
+int r2 = (inst >> 5) & 31;
+uint32_t next = pc + 2;
+uint32_t imm;
+uint32_t addr;
+int64_t prod;
+float f1, f2, fr;
+
+   // Bcond
+   if ((inst >> 13) == 4)
+   {
+      if (condition((inst >> 9) & 15))
+      {
+         next = pc + SEXT(inst & 0x1FF, 9);
+         cycles += TIME_BRANCH;
+      }
+      else
+         cycles += TIME_ALU;
+
+      pc = next;
+      return;
+   }
+
+   if (op >= 0x28)
+   {
+      imm = bus.read(pc + 2, 2);
+      next = pc + 4;
+   }
+   else
+      imm = 0;
+
+   cycles += TIME_ALU;
+
+   switch (op)
+   {
+      case 0x00:  r[r2] = r[r1];                            break;    // MOV
+      case 0x01:  r[r2] = add(r[r2], r[r1]);                break;    // ADD
+      case 0x02:  r[r2] = sub(r[r2], r[r1]);                break;    // SUB
+      case 0x03:  sub(r[r2], r[r1]);                        break;    // CMP
+      case 0x04:  r[r2] = shl(r[r2], r[r1] & 31);           break;    // SHL
+      case 0x05:  r[r2] = shr(r[r2], r[r1] & 31);           break;    // SHR
+      case 0x07:  r[r2] = sar(r[r2], r[r1] & 31);           break;    // SAR
+
+      case 0x06:                                                      // JMP [reg1]
+         next = r[r1] & ~1;
+         cycles += TIME_BRANCH - TIME_ALU;
+         break;
+
+      case 0x08:                                                      // MUL
+         prod = (int64_t)(int32_t) r[r2] * (int32_t) r[r1];
+         r[30] = (uint32_t)(prod >> 32);
+         r[r2] = (uint32_t) prod;
+         set_zs(r[r2]);
+         if (prod != (int64_t)(int32_t) r[r2])
+            sr[V810_PSW] |= PSW_OV;
+         cycles += TIME_MUL - TIME_ALU;
+         break;
+
+      case 0x0A:                                                      // MULU
+         prod = (int64_t)((uint64_t) r[r2] * r[r1]);
+         r[30] = (uint32_t)((uint64_t) prod >> 32);
+         r[r2] = (uint32_t) prod;
+         set_zs(r[r2]);
+         if (r[30] != 0)
+            sr[V810_PSW] |= PSW_OV;
+         cycles += TIME_MUL - TIME_ALU;
+         break;
+
+      case 0x09:                                                      // DIV
+         if (r[r1] == 0)
+         {
+            stop("division by zero");
+            return;
+         }
+         if ((r[r2] == 0x80000000) && (r[r1] == 0xFFFFFFFF))
+         {
+            r[30] = 0;
+            set_zs(r[r2]);
+            sr[V810_PSW] |= PSW_OV;
+         }
+         else
+         {
+            int32_t a = r[r2], b = r[r1];
+
+            r[30] = a % b;
+            r[r2] = a / b;
+            set_zs(r[r2]);
+         }
+         cycles += TIME_DIV - TIME_ALU;
+         break;
+
+      case 0x0B:                                                      // DIVU
+         if (r[r1] == 0)
+         {
+            stop("division by zero");
+            return;
+         }
+         {
+            uint32_t a = r[r2], b = r[r1];
+
+            r[30] = a % b;
+            r[r2] = a / b;
+            set_zs(r[r2]);
+         }
+         cycles += TIME_DIVU - TIME_ALU;
+         break;
+
+      case 0x0C:  r[r2] |= r[r1];   set_zs(r[r2]);          break;    // OR
+      case 0x0D:  r[r2] &= r[r1];   set_zs(r[r2]);          break;    // AND
+      case 0x0E:  r[r2] ^= r[r1];   set_zs(r[r2]);          break;    // XOR
+      case 0x0F:  r[r2] = ~r[r1];   set_zs(r[r2]);          break;    // NOT
+
+      case 0x10:  r[r2] = SEXT(r1, 5);                      break;    // MOV imm5
+      case 0x11:  r[r2] = add(r[r2], SEXT(r1, 5));          break;    // ADD imm5
+      case 0x12:  r[r2] = condition(r1 & 15) ? 1 : 0;       break;    // SETF
+      case 0x13:  sub(r[r2], SEXT(r1, 5));                  break;    // CMP imm5
+      case 0x14:  r[r2] = shl(r[r2], r1);                   break;    // SHL imm5
+      case 0x15:  r[r2] = shr(r[r2], r1);                   break;    // SHR imm5
+      case 0x17:  r[r2] = sar(r[r2], r1);                   break;    // SAR imm5
+
+      case 0x16:                                                      // CLI
+         sr[V810_PSW] &= ~PSW_ID;
+         cycles += TIME_SEI_CLI - TIME_ALU;
+         break;
+
+      case 0x1E:                                                      // SEI
+         sr[V810_PSW] |= PSW_ID;
+         cycles += TIME_SEI_CLI - TIME_ALU;
+         break;
+
+      case 0x18:                                                      // TRAP
+         cycles += TIME_TRAP - TIME_ALU;
+         pc = next;
+         if (!bus.trap(r1))
+            stopped = true;
+         return;
+
+      case 0x19:                                                      // RETI
+         if (sr[V810_PSW] & PSW_NP)
+         {
+            next = sr[V810_FEPC];
+            sr[V810_PSW] = sr[V810_FEPSW];
+         }
+         else
+         {
+            next = sr[V810_EIPC];
+            sr[V810_PSW] = sr[V810_EIPSW];
+         }
+         cycles += TIME_RETI - TIME_ALU;
+         break;
+
+      case 0x1A:                                                      // HALT
+         halted = true;
+         break;
+
+      case 0x1C:  ldsr(r1, r[r2]);                          break;    // LDSR
+      case 0x1D:  r[r2] = sr[r1];                           break;    // STSR
+
+      case 0x1F:                                                      // bit strings
+         if ((r1 & 0x10) || ((r1 >= 4) && (r1 < 8)))
+         {
+            stop("invalid bit string instruction");
+            return;
+         }
+         bit_string(r1);
+         break;
+
+      case 0x28:  r[r2] = r[r1] + SEXT(imm, 16);            break;    // MOVEA
+      case 0x29:  r[r2] = add(r[r1], SEXT(imm, 16));        break;    // ADDI
+      case 0x2C:  r[r2] = r[r1] | imm;   set_zs(r[r2]);     break;    // ORI
+      case 0x2D:  r[r2] = r[r1] & imm;   set_zs(r[r2]);     break;    // ANDI
+      case 0x2E:  r[r2] = r[r1] ^ imm;   set_zs(r[r2]);     break;    // XORI
+      case 0x2F:  r[r2] = r[r1] + (imm << 16);              break;    // MOVHI
+
+      case 0x2A:                                                      // JR
+      case 0x2B:                                                      // JAL
+         if (op == 0x2B)
+            r[31] = next;
+         next = pc + SEXT(((inst & 0x3FF) << 16) | imm, 26);
+         cycles += TIME_BRANCH - TIME_ALU;
+         break;
+
+      case 0x30:                                                      // LD.B
+      case 0x31:                                                      // LD.H
+      case 0x33:                                                      // LD.W
+      case 0x38:                                                      // IN.B
+      case 0x39:                                                      // IN.H
+      case 0x3B:                                                      // IN.W
+      {
+         int size = ((op & 3) == 0) ? 1 : ((op & 3) == 1) ? 2 : 4;
+         uint32_t v;
+
+         addr = (r[r1] + SEXT(imm, 16)) & ~(size - 1);
+         v = (op & 8) ? bus.in(addr, size) : bus.read(addr, size);
+
+         if (!(op & 8) && (size == 1))
+            v = SEXT(v, 8);
+         else if (!(op & 8) && (size == 2))
+            v = SEXT(v, 16);
+
+         r[r2] = v;
+         cycles += TIME_LOAD - TIME_ALU;
+         break;
+      }
+
+      case 0x34:                                                      // ST.B
+      case 0x35:                                                      // ST.H
+      case 0x37:                                                      // ST.W
+      case 0x3C:                                                      // OUT.B
+      case 0x3D:                                                      // OUT.H
+      case 0x3F:                                                      // OUT.W
+      {
+         int size = ((op & 3) == 0) ? 1 : ((op & 3) == 1) ? 2 : 4;
+
+         addr = (r[r1] + SEXT(imm, 16)) & ~(size - 1);
+         if (op & 8)
+            bus.out(addr, r[r2], size);
+         else
+            bus.write(addr, r[r2], size);
+
+         cycles += TIME_STORE - TIME_ALU;
+         break;
+      }
+
+      case 0x3A:                                                      // CAXI
+      {
+         uint32_t v;
+
+         addr = (r[r1] + SEXT(imm, 16)) & ~3;
+         v = bus.read(addr, 4);
+         sub(r[r2], v);
+         bus.write(addr, (r[r2] == v) ? r[30] : v, 4);
+         r[r2] = v;
+         cycles += TIME_CAXI - TIME_ALU;
+         break;
+      }
+
+      case 0x3E:                                                      // floating point
+         memcpy(&f1, &r[r1], 4);
+         memcpy(&f2, &r[r2], 4);
+
+         switch (imm >> 10)
+         {
+            case 0x00:                                                // CMPF.S
+               set_float(f2 - f1);
+               cycles += TIME_CMPF - TIME_ALU;
+               break;
+
+            case 0x02:                                                // CVT.WS
+               fr = (float)(int32_t) r[r1];
+               memcpy(&r[r2], &fr, 4);
+               set_float(fr);
+               cycles += TIME_CVT - TIME_ALU;
+               break;
+
+            case 0x03:                                                // CVT.SW
+            case 0x0B:                                                // TRNC.SW
+               r[r2] = (uint32_t)(int32_t)(((imm >> 10) == 0x03) ? nearbyintf(f1) : truncf(f1));
+               set_zs(r[r2]);
+               cycles += TIME_CVT - TIME_ALU;
+               break;
+
+            case 0x04:                                                // ADDF.S
+            case 0x05:                                                // SUBF.S
+            case 0x06:                                                // MULF.S
+            case 0x07:                                                // DIVF.S
+               switch (imm >> 10)
+               {
+                  case 0x04: fr = f2 + f1;  break;
+                  case 0x05: fr = f2 - f1;  break;
+                  case 0x06: fr = f2 * f1;  break;
+                  default:   fr = f2 / f1;  break;
+               }
+               memcpy(&r[r2], &fr, 4);
+               set_float(fr);
+               cycles += (((imm >> 10) == 0x07) ? TIME_DIVF : TIME_FLOAT) - TIME_ALU;
+               break;
+
+            default:
+               stop("invalid floating point instruction");
+               return;
+         }
+         break;
+
+      default:
+         stop("invalid instruction");
+         return;
+   }
+
+   r[0] = 0;
+   pc = next;
+}
@@ -0,0 +1,94 @@
+/*
+ * v810.h - interpreter for the NEC V810 CPU of the PC-FX
+ *
+ * Runs linked PC-FX programs on the development machine (see fxrun.cpp).
+ * Memory and I/O are reached through a V810Bus, which the machine model
+ * provides; the interpreter keeps a count of CPU cycles, using the
+ * execution times in the V810 user's manual (with no wait states - the
+ * bus adds those for slow devices, such as the flash cart).
+ *
+ * Integer, floating point and bit string instructions are implemented;
+ * the cache and debug registers are accepted but have no effect.
+ */
+#ifndef V810_H
+#define V810_H
+
+#include <stdint.h>
+
+// system registers
+#define V810_EIPC        0
+#define V810_EIPSW       1
+#define V810_FEPC        2
+#define V810_FEPSW       3
+#define V810_ECR         4
+#define V810_PSW         5
+#define V810_PIR         6
+#define V810_TKCW        7
+#define V810_CHCW        24
+#define V810_ADTRE       25
+
+// PSW bits
+#define PSW_Z            0x00000001
+#define PSW_S            0x00000002
+#define PSW_OV           0x00000004
+#define PSW_CY           0x00000008
+#define PSW_ID           0x00001000
+#define PSW_AE           0x00002000
+#define PSW_EP           0x00004000
+#define PSW_NP           0x00008000
+#define PSW_I_SHIFT      16
+#define PSW_I_MASK       0x000F0000
+
+class V810Bus
+{
+public:
+   virtual ~V810Bus() {}
+
+   // 'size' is 1, 2 or 4 bytes; addresses are already aligned
+   virtual uint32_t read(uint32_t addr, int size) = 0;
+   virtual void     write(uint32_t addr, uint32_t value, int size) = 0;
+   virtual uint32_t in(uint32_t port, int size) = 0;
+   virtual void     out(uint32_t port, uint32_t value, int size) = 0;
+
+   // the handler for an interrupt at 'level' (0 if it should not be taken)
+   virtual uint32_t irq_vector(int level) = 0;
+
+   // TRAP 'vector'; return false to stop the CPU
+   virtual bool     trap(int vector) = 0;
+};
+
+class V810
+{
+public:
+   uint32_t r[32];
+   uint32_t sr[32];
+   uint32_t pc;
+   uint64_t cycles;
+   int      irq_level;        // highest interrupt requested (-1 for none)
+   bool     halted;           // HALT, until an interrupt
+   bool     stopped;          // by trap() or a fault
+   char     fault[128];
+
+   V810(V810Bus & bus);
+
+   void reset(uint32_t entry);
+   void step(void);
+
+private:
+   V810Bus & bus;
+
+   bool     condition(int cond);
+   void     set_zs(uint32_t v);
+   uint32_t add(uint32_t a, uint32_t b);
+   uint32_t sub(uint32_t a, uint32_t b);
+   uint32_t shl(uint32_t v, int n);
+   uint32_t shr(uint32_t v, int n);
+   uint32_t sar(uint32_t v, int n);
+   void     set_float(float f);
+   void     interrupt(int level);
+   void     ldsr(int reg, uint32_t value);
+   void     bit_string(int sub);
+   void     stop(const char * why);
+};
+
+#endif